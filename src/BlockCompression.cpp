@@ -0,0 +1,298 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifdef FILESERVER_HAVE_ZSTD
+    #include <zstd.h>
+#endif
+#ifdef FILESERVER_HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+namespace BlockCompression {
+
+namespace {
+
+constexpr std::uint32_t footer_magic = 0x42435346;  // 字节序列 "FSCB"
+constexpr std::uint32_t format_version = 1;
+constexpr std::size_t index_entry_size = 17;
+constexpr std::size_t footer_size = 40;
+
+void putLE(char* out, std::uint64_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+std::uint64_t getLE(const char* in, std::size_t bytes) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+        value |= std::uint64_t(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+// 压缩一个块；压缩失败或收益不足5%时返回原始数据
+Codec compressBlock(const char* data, std::size_t size, std::vector<char>& out) {
+    Codec codec = preferredCodec();
+    [[maybe_unused]] std::size_t limit = size - size / 20;
+
+    switch (codec) {
+    #ifdef FILESERVER_HAVE_ZSTD
+        case Codec::Zstd: {
+            out.resize(ZSTD_compressBound(size));
+            std::size_t result = ZSTD_compress(out.data(), out.size(), data, size, 3);
+            if (!ZSTD_isError(result) && result < limit) {
+                out.resize(result);
+                return Codec::Zstd;
+            }
+            break;
+        }
+    #endif
+    #ifdef FILESERVER_HAVE_ZLIB
+        case Codec::Zlib: {
+            uLongf dest_size = compressBound(static_cast<uLong>(size));
+            out.resize(dest_size);
+            int result = compress2(reinterpret_cast<Bytef*>(out.data()), &dest_size,
+                                   reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size), 6);
+            if (result == Z_OK && dest_size < limit) {
+                out.resize(dest_size);
+                return Codec::Zlib;
+            }
+            break;
+        }
+    #endif
+        default:
+            break;
+    }
+
+    out.assign(data, data + size);
+    return Codec::Raw;
+}
+
+bool decompressBlock(const BlockEntry& block, const char* data, char* out) {
+    switch (block.codec) {
+        case Codec::Raw:
+            if (block.stored_size != block.original_size) return false;
+            std::memcpy(out, data, block.stored_size);
+            return true;
+    #ifdef FILESERVER_HAVE_ZSTD
+        case Codec::Zstd: {
+            std::size_t result = ZSTD_decompress(out, block.original_size, data, block.stored_size);
+            return !ZSTD_isError(result) && result == block.original_size;
+        }
+    #endif
+    #ifdef FILESERVER_HAVE_ZLIB
+        case Codec::Zlib: {
+            uLongf dest_size = block.original_size;
+            int result = uncompress(reinterpret_cast<Bytef*>(out), &dest_size,
+                                    reinterpret_cast<const Bytef*>(data), block.stored_size);
+            return result == Z_OK && dest_size == block.original_size;
+        }
+    #endif
+        default:
+            // 该压缩算法未编译进本程序
+            return false;
+    }
+}
+
+struct Footer {
+    std::uint64_t block_count = 0;
+    std::uint64_t index_offset = 0;
+    std::uint64_t original_size = 0;
+};
+
+bool parseFooter(const char* footer, std::uint64_t file_size, Footer& parsed) {
+    if (getLE(footer, 4) != footer_magic || getLE(footer + 4, 4) != format_version
+        || getLE(footer + 8, 4) != block_size) {
+        return false;
+    }
+
+    parsed.block_count = getLE(footer + 16, 8);
+    parsed.index_offset = getLE(footer + 24, 8);
+    parsed.original_size = getLE(footer + 32, 8);
+    // 布局不自洽的文件视为普通文件
+    return parsed.block_count <= file_size / index_entry_size
+        && parsed.index_offset <= file_size
+        && parsed.index_offset + parsed.block_count * index_entry_size + footer_size == file_size;
+}
+
+bool parseEntries(const char* entries, const Footer& parsed, std::uint64_t file_size, Index& index) {
+    index.original_size = parsed.original_size;
+    index.stored_size = file_size;
+    index.blocks.resize(parsed.block_count);
+    std::uint64_t expected_offset = 0;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < parsed.block_count; ++i) {
+        const char* p = entries + i * index_entry_size;
+        BlockEntry& block = index.blocks[i];
+        block.offset = getLE(p, 8);
+        block.stored_size = static_cast<std::uint32_t>(getLE(p + 8, 4));
+        block.original_size = static_cast<std::uint32_t>(getLE(p + 12, 4));
+        block.codec = static_cast<Codec>(p[16]);
+        bool last_block = i + 1 == parsed.block_count;
+        if (block.offset != expected_offset || block.original_size > block_size
+            || (!last_block && block.original_size != block_size)) {
+            return false;
+        }
+        expected_offset += block.stored_size;
+        total += block.original_size;
+    }
+    return expected_offset == parsed.index_offset && total == parsed.original_size;
+}
+
+} // namespace
+
+Codec preferredCodec() {
+#if defined(FILESERVER_HAVE_ZSTD)
+    return Codec::Zstd;
+#elif defined(FILESERVER_HAVE_ZLIB)
+    return Codec::Zlib;
+#else
+    return Codec::Raw;
+#endif
+}
+
+bool encode(const std::vector<char>& data, std::vector<char>& out, ThreadPool& pool,
+            bool compress, std::stop_token stop) {
+    std::size_t block_count = (data.size() + block_size - 1) / block_size;
+    std::vector<std::vector<char>> compressed(block_count);
+    std::vector<BlockEntry> blocks(block_count);
+
+    // 各块独立压缩，分散到所有核心上
+    pool.parallelFor(block_count, [&](std::size_t i) {
+        if (stop.stop_requested()) return;
+        std::size_t begin = i * block_size;
+        std::size_t size = std::min<std::size_t>(block_size, data.size() - begin);
+        if (compress) {
+            blocks[i].codec = compressBlock(data.data() + begin, size, compressed[i]);
+        } else {
+            compressed[i].assign(data.data() + begin, data.data() + begin + size);
+            blocks[i].codec = Codec::Raw;
+        }
+        blocks[i].original_size = static_cast<std::uint32_t>(size);
+        blocks[i].stored_size = static_cast<std::uint32_t>(compressed[i].size());
+    });
+    if (stop.stop_requested()) {
+        out.clear();
+        return false;
+    }
+
+    std::uint64_t offset = 0;
+    for (std::size_t i = 0; i < block_count; ++i) {
+        blocks[i].offset = offset;
+        offset += compressed[i].size();
+    }
+
+    out.clear();
+    out.reserve(offset + block_count * index_entry_size + footer_size);
+    for (const auto& block : compressed) {
+        out.insert(out.end(), block.begin(), block.end());
+    }
+
+    out.resize(offset + block_count * index_entry_size + footer_size);
+    char* p = out.data() + offset;
+    for (const auto& block : blocks) {
+        putLE(p, block.offset, 8);
+        putLE(p + 8, block.stored_size, 4);
+        putLE(p + 12, block.original_size, 4);
+        p[16] = static_cast<char>(block.codec);
+        p += index_entry_size;
+    }
+    putLE(p, footer_magic, 4);
+    putLE(p + 4, format_version, 4);
+    putLE(p + 8, block_size, 4);
+    putLE(p + 12, 0, 4);
+    putLE(p + 16, block_count, 8);
+    putLE(p + 24, offset, 8);
+    putLE(p + 32, data.size(), 8);
+    return true;
+}
+
+bool readIndex(std::istream& in, std::uint64_t file_size, Index& index) {
+    if (file_size < footer_size) return false;
+
+    char footer[footer_size];
+    in.seekg(static_cast<std::streamoff>(file_size - footer_size));
+    if (!in.read(footer, footer_size)) return false;
+
+    Footer parsed;
+    if (!parseFooter(footer, file_size, parsed)) return false;
+
+    std::vector<char> entries(parsed.block_count * index_entry_size);
+    in.seekg(static_cast<std::streamoff>(parsed.index_offset));
+    if (!in.read(entries.data(), entries.size())) return false;
+    return parseEntries(entries.data(), parsed, file_size, index);
+}
+
+bool hasIndex(const std::vector<char>& data) {
+    if (data.size() < footer_size) return false;
+
+    Footer parsed;
+    Index index;
+    return parseFooter(data.data() + data.size() - footer_size, data.size(), parsed)
+        && parseEntries(data.data() + parsed.index_offset, parsed, data.size(), index);
+}
+
+bool readStoredRange(std::istream& in, const Index& index, std::uint64_t offset,
+                     std::uint64_t length, StoredRange& range) {
+    range.offset = offset;
+    range.length = offset < index.original_size ? std::min(length, index.original_size - offset) : 0;
+    range.bytes.clear();
+    if (range.length == 0) return true;
+
+    // 除最后一块外每块原始大小都是block_size，涉及的块在文件中是连续的，一次读出
+    std::size_t first = offset / block_size;
+    std::size_t last = (offset + range.length - 1) / block_size;
+    std::uint64_t stored_begin = index.blocks[first].offset;
+    std::uint64_t stored_end = index.blocks[last].offset + index.blocks[last].stored_size;
+    range.first_block = first;
+    range.bytes.resize(stored_end - stored_begin);
+    in.seekg(static_cast<std::streamoff>(stored_begin));
+    return static_cast<bool>(in.read(range.bytes.data(), range.bytes.size()));
+}
+
+bool decodeRange(const Index& index, const StoredRange& range, std::vector<char>& data,
+                 ThreadPool& pool, std::stop_token stop) {
+    data.resize(range.length);
+    if (range.length == 0) return true;
+
+    std::uint64_t offset = range.offset;
+    std::uint64_t length = range.length;
+    std::size_t first = range.first_block;
+    std::size_t last = (offset + length - 1) / block_size;
+    std::uint64_t stored_begin = index.blocks[first].offset;
+
+    std::atomic<bool> ok{true};
+    pool.parallelFor(last - first + 1, [&](std::size_t i) {
+        if (stop.stop_requested()) {
+            ok = false;
+            return;
+        }
+        const BlockEntry& block = index.blocks[first + i];
+        std::uint64_t block_begin = std::uint64_t(first + i) * block_size;
+        const char* source = range.bytes.data() + (block.offset - stored_begin);
+
+        // 完整落在范围内的块直接解压到输出，首尾块先解压到临时缓冲
+        std::uint64_t copy_begin = std::max(offset, block_begin);
+        std::uint64_t copy_end = std::min(offset + length, block_begin + block.original_size);
+        char* target = data.data() + (copy_begin - offset);
+        if (copy_begin == block_begin && copy_end == block_begin + block.original_size) {
+            if (!decompressBlock(block, source, target)) ok = false;
+            return;
+        }
+
+        std::vector<char> buffer(block.original_size);
+        if (!decompressBlock(block, source, buffer.data())) {
+            ok = false;
+            return;
+        }
+        std::memcpy(target, buffer.data() + (copy_begin - block_begin), copy_end - copy_begin);
+    });
+
+    if (!ok) data.clear();
+    return ok;
+}
+
+} // namespace BlockCompression
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <stop_token>
+#include <vector>
+#include "ThreadPool.h"
+
+// 可随机访问的分块压缩格式：文件被切分为定长块分别压缩，
+// 文件末尾是块索引和定长尾部，读取任意范围时只需解压涉及的块。
+//
+//   [块0][块1]...[块N-1][索引: N * 17字节][尾部: 40字节]
+//
+// 所有整数均为小端序。压缩后没有明显变小的块以原始数据存储。
+// 格式只由尾部识别，因此内容恰好能被解析为该格式的普通文件也必须以该格式
+// (原始块)存储，见hasIndex。
+namespace BlockCompression {
+
+constexpr std::uint32_t block_size = 256 * 1024;
+
+enum class Codec : std::uint8_t {
+    Raw = 0,
+    Zstd = 1,
+    Zlib = 2
+};
+
+struct BlockEntry {
+    std::uint64_t offset = 0;         // 块在文件中的偏移
+    std::uint32_t stored_size = 0;
+    std::uint32_t original_size = 0;
+    Codec codec = Codec::Raw;
+};
+
+struct Index {
+    std::uint64_t original_size = 0;
+    std::uint64_t stored_size = 0;    // 整个文件在磁盘上的大小
+    std::vector<BlockEntry> blocks;
+};
+
+// 本次构建可用的压缩算法，没有可用算法时返回Codec::Raw
+Codec preferredCodec();
+
+// 分块并在线程池上并行压缩，生成完整的文件内容；compress为false时所有块以原始数据存储。
+// 只在内存中进行，调用方可以在不持有文件锁的情况下完成压缩；
+// 每块开始前检查stop，请求停止时返回false
+bool encode(const std::vector<char>& data, std::vector<char>& out, ThreadPool& pool,
+            bool compress = true, std::stop_token stop = {});
+
+// 读取文件尾部的索引；不是该格式的文件返回false
+bool readIndex(std::istream& in, std::uint64_t file_size, Index& index);
+
+// data本身能否被解析为该格式，用于判断普通上传是否需要以原始块存储
+bool hasIndex(const std::vector<char>& data);
+
+// 原始数据中[offset, offset + length)涉及的块在文件中的连续片段
+struct StoredRange {
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+    std::size_t first_block = 0;
+    std::vector<char> bytes;
+};
+
+// 读取范围涉及的块，不解压；超出文件末尾的部分视为空，与未压缩文件一致
+bool readStoredRange(std::istream& in, const Index& index, std::uint64_t offset,
+                     std::uint64_t length, StoredRange& range);
+
+// 在线程池上并行解压readStoredRange读出的块，每块开始前检查stop
+bool decodeRange(const Index& index, const StoredRange& range, std::vector<char>& data,
+                 ThreadPool& pool, std::stop_token stop = {});
+
+} // namespace BlockCompression
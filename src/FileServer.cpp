@@ -1,53 +1,132 @@
 #include "FileServer.h"
+#include "Trace.h"
+#include "BlockCompression.h"
+#include <algorithm>
+#include <limits>
 #include <chrono>
 #include <sstream>
 #include <iostream>
 #include <ctime>
+#include <unordered_set>
 
-FileServer::FileServer(const std::string& root_path) : root_path_(root_path) {
+namespace {
+
+// 标记批量请求中重复出现的文件，只保留第一次出现，避免多个线程同时写同一文件
+std::vector<bool> findDuplicates(const std::filesystem::path& root, const std::vector<std::string>& filenames) {
+    std::vector<bool> duplicate(filenames.size(), false);
+    std::unordered_set<std::string> seen;
+    for (std::size_t i = 0; i < filenames.size(); ++i) {
+        duplicate[i] = !seen.insert((root / filenames[i]).lexically_normal().string()).second;
+    }
+    return duplicate;
+}
+
+FileServer::Result duplicateResult(const std::string& filename) {
+    return {FileServer::ErrorCode::ALREADY_EXISTS, "批量请求中文件重复: " + filename};
+}
+
+FileServer::Result cancelledResult(const std::string& filename) {
+    return {FileServer::ErrorCode::CANCELLED, "操作已取消: " + filename};
+}
+
+} // namespace
+
+FileServer::FileServer(const std::string& root_path)
+    : root_path_(root_path)
+    , pool_(std::make_unique<ThreadPool>()) {
     if (!std::filesystem::exists(root_path_)) {
         std::filesystem::create_directories(root_path_);
     }
 }
 
 bool FileServer::uploadFile(const std::string& filename, const std::vector<char>& data) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    try {
-        auto file_path = root_path_ / filename;
-        std::ofstream file(file_path, std::ios::binary);
-        if (!file) return false;
-        
-        file.write(data.data(), data.size());
-        logOperation("UPLOAD", filename);
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Upload error: " << e.what() << std::endl;
+    FS_TRACE_SCOPE("FileServer::uploadFile");
+    auto result = writeFileData(filename, data);
+    if (result.code != ErrorCode::SUCCESS) {
+        if (result.code == ErrorCode::UNKNOWN_ERROR) {
+            std::cerr << "Upload error: " << result.message << std::endl;
+        }
         return false;
     }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperation("UPLOAD", filename);
+    return true;
 }
 
 std::vector<char> FileServer::downloadFile(const std::string& filename) {
+    FS_TRACE_SCOPE("FileServer::downloadFile");
+    std::vector<char> buffer;
+    auto result = readFileData(filename, buffer);
+    if (result.code != ErrorCode::SUCCESS) {
+        if (result.code == ErrorCode::UNKNOWN_ERROR) {
+            std::cerr << "Download error: " << result.message << std::endl;
+        }
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperation("DOWNLOAD", filename);
+    return buffer;
+}
+
+std::vector<char> FileServer::downloadRange(const std::string& filename, std::uint64_t offset, std::uint64_t length) {
+    FS_TRACE_SCOPE("FileServer::downloadRange");
+    std::vector<char> buffer;
+    auto result = readFileRange(filename, offset, length, buffer);
+    if (result.code != ErrorCode::SUCCESS) {
+        if (result.code == ErrorCode::UNKNOWN_ERROR) {
+            std::cerr << "Download error: " << result.message << std::endl;
+        }
+        return {};
+    }
     std::lock_guard<std::mutex> lock(mutex_);
+    logOperation("DOWNLOAD_RANGE", filename);
+    return buffer;
+}
+
+void FileServer::setCompressionEnabled(bool enabled) {
+    compression_enabled_ = enabled;
+}
+
+bool FileServer::compressionEnabled() const {
+    return compression_enabled_;
+}
+
+FileServer::CompressionStats FileServer::fileCompressionStats(const std::string& filename) const {
     try {
         auto file_path = root_path_ / filename;
-        std::ifstream file(file_path, std::ios::binary | std::ios::ate);
-        if (!file) return {};
-        
-        auto size = file.tellg();
-        std::vector<char> buffer(size);
-        
-        file.seekg(0);
-        file.read(buffer.data(), size);
-        
-        logOperation("DOWNLOAD", filename);
-        return buffer;
+        std::shared_lock<std::shared_mutex> lock(pathLock(file_path));
+        return compressionStatsOf(file_path);
     } catch (const std::exception& e) {
-        std::cerr << "Download error: " << e.what() << std::endl;
+        std::cerr << "Compression stats error: " << e.what() << std::endl;
         return {};
     }
 }
 
+FileServer::CompressionStats FileServer::storeCompressionStats() const {
+    CompressionStats total;
+    try {
+        for (const auto& entry : std::filesystem::directory_iterator(root_path_)) {
+            if (entry.is_regular_file() && entry.path().filename() != "server.log") {
+                std::shared_lock<std::shared_mutex> lock(pathLock(entry.path()));
+                auto stats = compressionStatsOf(entry.path());
+                total.original_bytes += stats.original_bytes;
+                total.stored_bytes += stats.stored_bytes;
+                total.compressed_files += stats.compressed_files;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Compression stats error: " << e.what() << std::endl;
+    }
+    return total;
+}
+
 void FileServer::logOperation(const std::string& operation, const std::string& filename) {
+    logOperations(operation, {filename});
+}
+
+void FileServer::logOperations(const std::string& operation, const std::vector<std::string>& filenames) {
+    if (filenames.empty()) return;
+    
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
     
@@ -63,27 +142,30 @@ void FileServer::logOperation(const std::string& operation, const std::string& f
         time_string.pop_back();
     }
     
+    // 批量操作只打开一次日志文件
     std::ofstream log_file(root_path_ / "server.log", std::ios::app);
-    log_file << time_string << " - " << operation << ": " << filename << std::endl;
+    for (const auto& filename : filenames) {
+        log_file << time_string << " - " << operation << ": " << filename << '\n';
+    }
+    log_file.flush();
 }
 
 bool FileServer::deleteFile(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    try {
-        auto file_path = root_path_ / filename;
-        if (std::filesystem::exists(file_path)) {
-            std::filesystem::remove(file_path);
-            logOperation("DELETE", filename);
-            return true;
+    FS_TRACE_SCOPE("FileServer::deleteFile");
+    auto result = removeFile(filename);
+    if (result.code != ErrorCode::SUCCESS) {
+        if (result.code == ErrorCode::UNKNOWN_ERROR) {
+            std::cerr << "Delete error: " << result.message << std::endl;
         }
         return false;
-    } catch (const std::exception& e) {
-        std::cerr << "Delete error: " << e.what() << std::endl;
-        return false;
     }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperation("DELETE", filename);
+    return true;
 }
 
 std::vector<std::string> FileServer::listFiles() const {
+    FS_TRACE_SCOPE("FileServer::listFiles");
     std::lock_guard<std::mutex> lock(mutex_);
     std::vector<std::string> files;
     try {
@@ -98,6 +180,282 @@ std::vector<std::string> FileServer::listFiles() const {
     return files;
 }
 
+std::vector<FileServer::Result> FileServer::uploadBatch(const std::vector<UploadItem>& items) {
+    FS_TRACE_SCOPE("FileServer::uploadBatch");
+    std::vector<Result> results(items.size());
+    std::vector<std::string> filenames;
+    for (const auto& item : items) {
+        filenames.push_back(item.filename);
+    }
+    auto duplicate = findDuplicates(root_path_, filenames);
+    pool_->parallelFor(items.size(), [&](std::size_t i) {
+        results[i] = duplicate[i] ? duplicateResult(items[i].filename)
+                                  : writeFileData(items[i].filename, items[i].data);
+    });
+    
+    std::vector<std::string> uploaded;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (results[i].code == ErrorCode::SUCCESS) {
+            uploaded.push_back(items[i].filename);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperations("UPLOAD", uploaded);
+    return results;
+}
+
+std::vector<FileServer::DownloadResult> FileServer::downloadBatch(const std::vector<std::string>& filenames) {
+    FS_TRACE_SCOPE("FileServer::downloadBatch");
+    std::vector<DownloadResult> results(filenames.size());
+    pool_->parallelFor(filenames.size(), [&](std::size_t i) {
+        results[i].result = readFileData(filenames[i], results[i].data);
+    });
+    
+    std::vector<std::string> downloaded;
+    for (std::size_t i = 0; i < filenames.size(); ++i) {
+        if (results[i].result.code == ErrorCode::SUCCESS) {
+            downloaded.push_back(filenames[i]);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperations("DOWNLOAD", downloaded);
+    return results;
+}
+
+std::vector<FileServer::Result> FileServer::deleteBatch(const std::vector<std::string>& filenames) {
+    FS_TRACE_SCOPE("FileServer::deleteBatch");
+    std::vector<Result> results(filenames.size());
+    auto duplicate = findDuplicates(root_path_, filenames);
+    pool_->parallelFor(filenames.size(), [&](std::size_t i) {
+        results[i] = duplicate[i] ? duplicateResult(filenames[i]) : removeFile(filenames[i]);
+    });
+    
+    std::vector<std::string> deleted;
+    for (std::size_t i = 0; i < filenames.size(); ++i) {
+        if (results[i].code == ErrorCode::SUCCESS) {
+            deleted.push_back(filenames[i]);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    logOperations("DELETE", deleted);
+    return results;
+}
+
+std::vector<FileServer::FileStat> FileServer::statBatch(const std::vector<std::string>& filenames) const {
+    FS_TRACE_SCOPE("FileServer::statBatch");
+    std::vector<FileStat> results(filenames.size());
+    pool_->parallelFor(filenames.size(), [&](std::size_t i) {
+        results[i].result = statFile(filenames[i], results[i]);
+    });
+    return results;
+}
+
+Task<FileServer::Result> FileServer::uploadAsync(std::string filename, std::vector<char> data, std::stop_token stop) {
+    co_await pool_->schedule();
+    FS_TRACE_SCOPE("FileServer::uploadAsync");
+    if (stop.stop_requested()) {
+        co_return cancelledResult(filename);
+    }
+    
+    auto result = writeFileData(filename, data, stop);
+    if (result.code == ErrorCode::SUCCESS) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logOperation("UPLOAD", filename);
+    }
+    co_return result;
+}
+
+Task<FileServer::DownloadResult> FileServer::downloadAsync(std::string filename, std::stop_token stop) {
+    co_await pool_->schedule();
+    FS_TRACE_SCOPE("FileServer::downloadAsync");
+    DownloadResult download;
+    if (stop.stop_requested()) {
+        download.result = cancelledResult(filename);
+        co_return download;
+    }
+    
+    download.result = readFileData(filename, download.data, stop);
+    if (download.result.code == ErrorCode::SUCCESS) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logOperation("DOWNLOAD", filename);
+    }
+    co_return download;
+}
+
+Task<FileServer::Result> FileServer::deleteAsync(std::string filename, std::stop_token stop) {
+    co_await pool_->schedule();
+    FS_TRACE_SCOPE("FileServer::deleteAsync");
+    if (stop.stop_requested()) {
+        co_return cancelledResult(filename);
+    }
+    
+    auto result = removeFile(filename);
+    if (result.code == ErrorCode::SUCCESS) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logOperation("DELETE", filename);
+    }
+    co_return result;
+}
+
+Task<FileServer::ListResult> FileServer::listAsync(std::stop_token stop) {
+    co_await pool_->schedule();
+    FS_TRACE_SCOPE("FileServer::listAsync");
+    ListResult list;
+    if (stop.stop_requested()) {
+        list.result = {ErrorCode::CANCELLED, "操作已取消"};
+        co_return list;
+    }
+    
+    list.files = listFiles();
+    co_return list;
+}
+
+std::shared_mutex& FileServer::pathLock(const std::filesystem::path& file_path) const {
+    // 同一文件的不同写法(如"a.txt"和"./a.txt")映射到同一把锁
+    auto key = file_path.lexically_normal().string();
+    return path_locks_[std::hash<std::string>{}(key) % path_locks_.size()];
+}
+
+FileServer::Result FileServer::writeFileData(const std::string& filename, const std::vector<char>& data,
+                                             std::stop_token stop) {
+    FS_TRACE_SCOPE("FileServer::writeFileData");
+    FS_TRACE_COUNTER("FileServer::bytesWritten", data.size());
+    try {
+        auto file_path = root_path_ / filename;
+        // 压缩使用线程池，必须在加锁之前完成。
+        // 未开启压缩时，恰好像压缩格式的数据以原始块存储，否则读取时会被误当作压缩文件
+        std::vector<char> encoded;
+        const std::vector<char>* contents = &data;
+        bool compress = compression_enabled_;
+        if (compress || BlockCompression::hasIndex(data)) {
+            if (!BlockCompression::encode(data, encoded, *pool_, compress, stop)) {
+                return cancelledResult(filename);
+            }
+            contents = &encoded;
+        }
+        if (stop.stop_requested()) {
+            return cancelledResult(filename);
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(pathLock(file_path));
+        std::ofstream file(file_path, std::ios::binary);
+        if (!file) return {ErrorCode::PERMISSION_DENIED, "无法写入文件: " + filename};
+        file.write(contents->data(), contents->size());
+        if (!file) return {ErrorCode::UNKNOWN_ERROR, "写入文件失败: " + filename};
+        return {};
+    } catch (const std::exception& e) {
+        return {ErrorCode::UNKNOWN_ERROR, e.what()};
+    }
+}
+
+FileServer::Result FileServer::readFileData(const std::string& filename, std::vector<char>& data,
+                                            std::stop_token stop) const {
+    FS_TRACE_SCOPE("FileServer::readFileData");
+    return readFileRange(filename, 0, std::numeric_limits<std::uint64_t>::max(), data, stop);
+}
+
+FileServer::Result FileServer::readFileRange(const std::string& filename, std::uint64_t offset,
+                                             std::uint64_t length, std::vector<char>& data,
+                                             std::stop_token stop) const {
+    try {
+        auto file_path = root_path_ / filename;
+        std::shared_lock<std::shared_mutex> lock(pathLock(file_path));
+        std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            if (!std::filesystem::exists(file_path)) {
+                return {ErrorCode::FILE_NOT_FOUND, "文件不存在: " + filename};
+            }
+            return {ErrorCode::PERMISSION_DENIED, "无法读取文件: " + filename};
+        }
+        
+        std::uint64_t size = static_cast<std::uint64_t>(file.tellg());
+        BlockCompression::Index index;
+        if (BlockCompression::readIndex(file, size, index)) {
+            // 在锁内读出涉及的块，解压使用线程池，在释放锁之后进行
+            BlockCompression::StoredRange range;
+            bool read_ok = BlockCompression::readStoredRange(file, index, offset, length, range);
+            file.close();
+            lock.unlock();
+            if (!read_ok || !BlockCompression::decodeRange(index, range, data, *pool_, stop)) {
+                data.clear();
+                if (stop.stop_requested()) return cancelledResult(filename);
+                return {ErrorCode::UNKNOWN_ERROR, "解压文件失败: " + filename};
+            }
+            return {};
+        }
+        
+        // 未压缩的文件
+        file.clear();
+        offset = std::min(offset, size);
+        length = std::min(length, size - offset);
+        data.resize(length);
+        
+        // 按块读取，块之间检查停止请求
+        file.seekg(static_cast<std::streamoff>(offset));
+        for (std::uint64_t done = 0; done < length; done += BlockCompression::block_size) {
+            if (stop.stop_requested()) {
+                data.clear();
+                return cancelledResult(filename);
+            }
+            auto chunk = std::min<std::uint64_t>(BlockCompression::block_size, length - done);
+            file.read(data.data() + done, static_cast<std::streamsize>(chunk));
+        }
+        return {};
+    } catch (const std::exception& e) {
+        data.clear();
+        return {ErrorCode::UNKNOWN_ERROR, e.what()};
+    }
+}
+
+FileServer::Result FileServer::removeFile(const std::string& filename) {
+    FS_TRACE_SCOPE("FileServer::removeFile");
+    try {
+        auto file_path = root_path_ / filename;
+        std::unique_lock<std::shared_mutex> lock(pathLock(file_path));
+        if (!std::filesystem::exists(file_path)) {
+            return {ErrorCode::FILE_NOT_FOUND, "文件不存在: " + filename};
+        }
+        std::filesystem::remove(file_path);
+        return {};
+    } catch (const std::exception& e) {
+        return {ErrorCode::UNKNOWN_ERROR, e.what()};
+    }
+}
+
+FileServer::Result FileServer::statFile(const std::string& filename, FileStat& stat) const {
+    FS_TRACE_SCOPE("FileServer::statFile");
+    try {
+        auto file_path = root_path_ / filename;
+        std::shared_lock<std::shared_mutex> lock(pathLock(file_path));
+        std::error_code ec;
+        auto status = std::filesystem::status(file_path, ec);
+        if (!std::filesystem::is_regular_file(status)) {
+            return {ErrorCode::FILE_NOT_FOUND, "文件不存在: " + filename};
+        }
+        // 压缩存储的文件报告原始大小
+        stat.size = compressionStatsOf(file_path).original_bytes;
+        stat.last_write_time = std::filesystem::last_write_time(file_path);
+        return {};
+    } catch (const std::exception& e) {
+        return {ErrorCode::UNKNOWN_ERROR, e.what()};
+    }
+}
+
+FileServer::CompressionStats FileServer::compressionStatsOf(const std::filesystem::path& file_path) const {
+    CompressionStats stats;
+    std::uint64_t size = std::filesystem::file_size(file_path);
+    stats.original_bytes = size;
+    stats.stored_bytes = size;
+    
+    std::ifstream file(file_path, std::ios::binary);
+    BlockCompression::Index index;
+    if (file && BlockCompression::readIndex(file, size, index)) {
+        stats.original_bytes = index.original_size;
+        stats.compressed_files = 1;
+    }
+    return stats;
+}
+
 bool FileServer::authenticate(const std::string& username, const std::string& password) {
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = users_.find(username);
@@ -115,4 +473,4 @@ bool FileServer::addUser(const std::string& username, const std::string& passwor
         return true;
     }
     return false;
-} 
\ No newline at end of file
+}
\ No newline at end of file
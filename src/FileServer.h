@@ -6,9 +6,61 @@
 #include <filesystem>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stop_token>
+#include "ThreadPool.h"
+#include "Task.h"
 
 class FileServer {
 public:
+    enum class ErrorCode {
+        SUCCESS,
+        FILE_NOT_FOUND,
+        PERMISSION_DENIED,
+        ALREADY_EXISTS,
+        UNKNOWN_ERROR,
+        CANCELLED  // 异步操作收到停止请求
+    };
+    
+    struct Result {
+        ErrorCode code = ErrorCode::SUCCESS;
+        std::string message;
+    };
+    
+    struct UploadItem {
+        std::string filename;
+        std::vector<char> data;
+    };
+    
+    struct DownloadResult {
+        Result result;
+        std::vector<char> data;
+    };
+    
+    struct FileStat {
+        Result result;
+        std::uintmax_t size = 0;
+        std::filesystem::file_time_type last_write_time{};
+    };
+    
+    struct ListResult {
+        Result result;
+        std::vector<std::string> files;
+    };
+    
+    struct CompressionStats {
+        std::uint64_t original_bytes = 0;
+        std::uint64_t stored_bytes = 0;
+        std::size_t compressed_files = 0;
+        
+        double ratio() const {
+            return stored_bytes == 0 ? 1.0 : static_cast<double>(original_bytes) / stored_bytes;
+        }
+    };
+    
     FileServer(const std::string& root_path);
     
     // 文件操作
@@ -16,6 +68,30 @@ public:
     std::vector<char> downloadFile(const std::string& filename);
     bool deleteFile(const std::string& filename);
     std::vector<std::string> listFiles() const;
+    // 读取文件的一部分，压缩存储的文件只解压涉及的块
+    std::vector<char> downloadRange(const std::string& filename, std::uint64_t offset, std::uint64_t length);
+    
+    // 静态压缩：开启后新上传的文件以分块压缩格式存储，读取时透明解压
+    void setCompressionEnabled(bool enabled);
+    bool compressionEnabled() const;
+    CompressionStats fileCompressionStats(const std::string& filename) const;
+    CompressionStats storeCompressionStats() const;
+    
+    // 批量文件操作，在内部线程池上并行执行，结果与输入一一对应。
+    // 上传和删除批次中重复的文件只执行第一项，其余返回ALREADY_EXISTS
+    std::vector<Result> uploadBatch(const std::vector<UploadItem>& items);
+    std::vector<DownloadResult> downloadBatch(const std::vector<std::string>& filenames);
+    std::vector<Result> deleteBatch(const std::vector<std::string>& filenames);
+    std::vector<FileStat> statBatch(const std::vector<std::string>& filenames) const;
+    
+    // 异步文件操作，在I/O线程池上执行，请求停止后返回CANCELLED：
+    // 下载在读取和解压的每个块之间检查停止；上传在压缩的每个块之间检查，
+    // 开始写入磁盘后不再中断，避免留下写了一半的文件。
+    // 同步调用方可以使用syncWait(server.uploadAsync(...))
+    Task<Result> uploadAsync(std::string filename, std::vector<char> data, std::stop_token stop = {});
+    Task<DownloadResult> downloadAsync(std::string filename, std::stop_token stop = {});
+    Task<Result> deleteAsync(std::string filename, std::stop_token stop = {});
+    Task<ListResult> listAsync(std::stop_token stop = {});
     
     // 用户认证
     bool authenticate(const std::string& username, const std::string& password);
@@ -25,19 +101,25 @@ private:
     std::filesystem::path root_path_;
     std::unordered_map<std::string, std::string> users_; // username -> password
     mutable std::mutex mutex_;
+    // 按文件名分条的读写锁：写入和删除独占，读取和查询共享。
+    // 持有期间只做磁盘I/O，压缩和解压在加锁前后进行，不会与线程池任务互相等待
+    mutable std::array<std::shared_mutex, 64> path_locks_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::atomic<bool> compression_enabled_{false};
     
     void logOperation(const std::string& operation, const std::string& filename);
+    void logOperations(const std::string& operation, const std::vector<std::string>& filenames);
     
-    enum class ErrorCode {
-        SUCCESS,
-        FILE_NOT_FOUND,
-        PERMISSION_DENIED,
-        ALREADY_EXISTS,
-        UNKNOWN_ERROR
-    };
+    std::shared_mutex& pathLock(const std::filesystem::path& file_path) const;
     
-    struct Result {
-        ErrorCode code;
-        std::string message;
-    };
+    // 单个文件的I/O，内部持有该文件的路径锁，日志由调用方负责
+    Result writeFileData(const std::string& filename, const std::vector<char>& data,
+                         std::stop_token stop = {});
+    Result readFileData(const std::string& filename, std::vector<char>& data,
+                        std::stop_token stop = {}) const;
+    Result readFileRange(const std::string& filename, std::uint64_t offset, std::uint64_t length,
+                         std::vector<char>& data, std::stop_token stop = {}) const;
+    Result removeFile(const std::string& filename);
+    Result statFile(const std::string& filename, FileStat& stat) const;
+    CompressionStats compressionStatsOf(const std::filesystem::path& file_path) const;
 }; 
\ No newline at end of file
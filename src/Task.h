@@ -0,0 +1,186 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <stdexcept>
+#include <utility>
+
+// 惰性协程任务：被co_await时才开始执行，完成后恢复等待者
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    void return_value(T result) { value.emplace(std::move(result)); }
+
+    T take() {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+
+    void take() {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+} // namespace detail
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit Task(handle_type handle) noexcept : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    // 等待空任务(已被移动)是编程错误，抛出异常而不是解引用空句柄
+    auto operator co_await() {
+        if (!handle_) {
+            throw std::logic_error("co_await on an empty Task");
+        }
+        struct Awaiter {
+            handle_type handle;
+            bool await_ready() const noexcept { return handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+// syncWait使用的驱动协程，结束挂起后才通知等待线程，保证可以安全销毁
+struct SyncWaitDriver {
+    struct promise_type {
+        std::binary_semaphore* done = nullptr;
+
+        SyncWaitDriver get_return_object() noexcept {
+            return SyncWaitDriver{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        auto final_suspend() const noexcept {
+            struct Notify {
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+                    handle.promise().done->release();
+                }
+                void await_resume() const noexcept {}
+            };
+            return Notify{};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    explicit SyncWaitDriver(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+    SyncWaitDriver(SyncWaitDriver&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    ~SyncWaitDriver() {
+        if (handle) handle.destroy();
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+SyncWaitDriver makeSyncWaitDriver(Task<T>& task, std::optional<T>& result, std::exception_ptr& exception) {
+    try {
+        result.emplace(co_await task);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+}
+
+inline SyncWaitDriver makeSyncWaitDriver(Task<void>& task, std::exception_ptr& exception) {
+    try {
+        co_await task;
+    } catch (...) {
+        exception = std::current_exception();
+    }
+}
+
+inline void runSyncWaitDriver(SyncWaitDriver& driver) {
+    std::binary_semaphore done(0);
+    driver.handle.promise().done = &done;
+    driver.handle.resume();
+    done.acquire();
+}
+
+} // namespace detail
+
+// 供同步调用方使用：阻塞当前线程直到任务完成并返回结果
+template <typename T>
+T syncWait(Task<T> task) {
+    std::optional<T> result;
+    std::exception_ptr exception;
+    auto driver = detail::makeSyncWaitDriver(task, result, exception);
+    detail::runSyncWaitDriver(driver);
+    if (exception) std::rethrow_exception(exception);
+    return std::move(*result);
+}
+
+inline void syncWait(Task<void> task) {
+    std::exception_ptr exception;
+    auto driver = detail::makeSyncWaitDriver(task, exception);
+    detail::runSyncWaitDriver(driver);
+    if (exception) std::rethrow_exception(exception);
+}
@@ -0,0 +1,135 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+#include <latch>
+
+namespace {
+// 当前线程在所属线程池中的队列编号
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t thread_count) {
+    if (thread_count == 0) {
+        // 文件操作以I/O为主，线程数多于核心数以填满磁盘队列
+        thread_count = std::max<std::size_t>(4, std::thread::hardware_concurrency() * 2);
+    }
+
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (std::size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // 池内线程提交的任务放入自己的队列，外部提交则轮流分配
+    std::size_t index = current_pool == this
+        ? current_index
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_cv_.notify_one();
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    if (count == 0) return;
+
+    std::latch done(static_cast<std::ptrdiff_t>(count));
+    std::mutex error_mutex;
+    std::exception_ptr first_error;
+    for (std::size_t i = 0; i < count; ++i) {
+        submit([&fn, &done, &error_mutex, &first_error, i] {
+            try {
+                fn(i);
+            } catch (...) {
+                // 记录第一个异常，全部完成后在调用线程重新抛出
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) first_error = std::current_exception();
+            }
+            done.count_down();
+        });
+    }
+
+    // 池内线程在还有排队任务时不能阻塞等待，否则所有线程都可能在等待而无人执行任务。
+    // 任务只会被取走而不会在队列间移动，所以一旦所有队列都为空，
+    // 本次的各项都已在其他线程上执行，此时阻塞等待即可，不必空转
+    if (current_pool == this) {
+        while (!done.try_wait()) {
+            std::function<void()> task;
+            if (!popTask(current_index, task)) {
+                break;
+            }
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            task();
+        }
+    }
+    done.wait();
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+bool ThreadPool::popTask(std::size_t index, std::function<void()>& task) {
+    // 先从自己队列的尾部取(后进先出)
+    {
+        auto& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // 再从其他队列的头部窃取
+    for (std::size_t offset = 1; offset < queues_.size(); ++offset) {
+        auto& victim = *queues_[(index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    while (true) {
+        std::function<void()> task;
+        if (popTask(index, task)) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this] {
+            return stopping_ || pending_.load(std::memory_order_relaxed) > 0;
+        });
+        if (stopping_ && pending_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+    }
+}
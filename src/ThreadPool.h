@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池：每个工作线程拥有自己的任务队列，
+// 空闲时从其他线程的队列头部窃取任务
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 提交任务
+    void submit(std::function<void()> task);
+    // 并行执行fn(0..count-1)并等待全部完成；在池内线程中调用时，等待期间会执行其他任务。
+    // fn抛出异常时，全部完成后重新抛出第一个异常
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+    // 在协程中co_await schedule()，之后的代码在池内线程上继续执行
+    auto schedule() noexcept {
+        struct Awaiter {
+            ThreadPool* pool;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                pool->submit([handle] { handle.resume(); });
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{this};
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool popTask(std::size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<std::size_t> next_queue_{0};
+    bool stopping_ = false;
+};
@@ -0,0 +1,298 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace Trace {
+
+namespace {
+
+constexpr std::size_t max_events_per_thread = 1 << 15;
+constexpr std::size_t max_retired_buffers = 16;
+constexpr int histogram_buckets = 64;
+
+enum class EventKind : std::uint8_t {
+    Span,
+    Counter
+};
+
+struct Event {
+    const char* name;
+    std::uint64_t start_ns;
+    std::uint64_t duration_ns;
+    std::int64_t value;
+    EventKind kind;
+};
+
+// 每线程的环形缓冲区，写满后覆盖最早的事件，长时间运行时始终保留最近的事件。
+// 每个槽位是一个顺序锁：只有所属线程写入，导出时若读到正被覆盖的槽位则跳过
+struct Slot {
+    std::atomic<std::uint64_t> sequence{0};  // 2 * 位置 + 2表示写入完成，奇数表示正在写入
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::uint64_t> start_ns{0};
+    std::atomic<std::uint64_t> duration_ns{0};
+    std::atomic<std::int64_t> value{0};
+    std::atomic<EventKind> kind{EventKind::Span};
+};
+
+struct ThreadBuffer {
+    std::uint32_t tid = 0;
+    std::unique_ptr<Slot[]> slots{new Slot[max_events_per_thread]};
+    std::atomic<std::uint64_t> head{0};  // 已写入的事件总数
+    bool retired = false;                // 所属线程已退出，受注册表的互斥锁保护
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // 按创建顺序
+    std::uint32_t next_tid = 1;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// 线程退出后其缓冲区仍可导出，但只保留最近退出的若干个，
+// 反复创建线程池或短生命周期线程时内存不会无限增长
+void retireBuffer(const std::shared_ptr<ThreadBuffer>& buffer) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    buffer->retired = true;
+
+    std::size_t retired = 0;
+    for (const auto& candidate : reg.buffers) {
+        if (candidate->retired) ++retired;
+    }
+    // 从最早的开始移除；没有任何事件的缓冲区直接移除
+    for (auto it = reg.buffers.begin(); it != reg.buffers.end();) {
+        bool empty = (*it)->head.load(std::memory_order_relaxed) == 0;
+        if ((*it)->retired && (empty || retired > max_retired_buffers)) {
+            it = reg.buffers.erase(it);
+            --retired;
+        } else {
+            ++it;
+        }
+    }
+}
+
+struct BufferOwner {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    BufferOwner() : buffer(std::make_shared<ThreadBuffer>()) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer->tid = reg.next_tid++;
+        reg.buffers.push_back(buffer);
+    }
+    ~BufferOwner() { retireBuffer(buffer); }
+};
+
+ThreadBuffer& threadBuffer() {
+    thread_local BufferOwner owner;
+    return *owner.buffer;
+}
+
+void record(const Event& event) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::uint64_t position = buffer.head.load(std::memory_order_relaxed);
+    Slot& slot = buffer.slots[position % max_events_per_thread];
+
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(event.duration_ns, std::memory_order_relaxed);
+    slot.value.store(event.value, std::memory_order_relaxed);
+    slot.kind.store(event.kind, std::memory_order_relaxed);
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+    buffer.head.store(position + 1, std::memory_order_release);
+}
+
+// 复制缓冲区中仍然有效的事件(按时间顺序)，overwritten累加已被覆盖的事件数
+std::vector<Event> snapshotEvents(const ThreadBuffer& buffer, std::uint64_t& overwritten) {
+    std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+    std::uint64_t begin = head > max_events_per_thread ? head - max_events_per_thread : 0;
+
+    std::vector<Event> events;
+    events.reserve(head - begin);
+    for (std::uint64_t position = begin; position < head; ++position) {
+        const Slot& slot = buffer.slots[position % max_events_per_thread];
+        std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        Event event{slot.name.load(std::memory_order_relaxed),
+                    slot.start_ns.load(std::memory_order_relaxed),
+                    slot.duration_ns.load(std::memory_order_relaxed),
+                    slot.value.load(std::memory_order_relaxed),
+                    slot.kind.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t after = slot.sequence.load(std::memory_order_relaxed);
+        // 读取期间该槽位已被更新的事件覆盖
+        if (before != 2 * position + 2 || after != before) continue;
+        events.push_back(event);
+    }
+    overwritten += head - events.size();
+    return events;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>> snapshotBuffers() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.buffers;
+}
+
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') out << '\\';
+        out << *p;
+    }
+    out << '"';
+}
+
+int bucketOf(std::uint64_t ns) {
+    int bucket = 0;
+    while (ns > 1 && bucket < histogram_buckets - 1) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+struct SpanStats {
+    std::uint64_t count = 0;
+    std::uint64_t total_ns = 0;
+    std::uint64_t max_ns = 0;
+    std::uint64_t histogram[histogram_buckets] = {};
+
+    // 以直方图桶的上界近似百分位
+    std::uint64_t percentile(double p) const {
+        std::uint64_t target = static_cast<std::uint64_t>(p * count);
+        std::uint64_t seen = 0;
+        for (int i = 0; i < histogram_buckets; ++i) {
+            seen += histogram[i];
+            if (seen > target) {
+                return std::min(max_ns, std::uint64_t(2) << i);
+            }
+        }
+        return max_ns;
+    }
+};
+
+struct CounterStats {
+    std::uint64_t count = 0;
+    std::int64_t sum = 0;
+    std::int64_t max = 0;
+};
+
+std::string formatNs(std::uint64_t ns) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (ns >= 1000000) {
+        out << ns / 1e6 << "ms";
+    } else if (ns >= 1000) {
+        out << ns / 1e3 << "us";
+    } else {
+        out << ns << "ns";
+    }
+    return out.str();
+}
+
+} // namespace
+
+std::uint64_t nowNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void recordSpan(const char* name, std::uint64_t start_ns, std::uint64_t end_ns) {
+    record({name, start_ns, end_ns > start_ns ? end_ns - start_ns : 0, 0, EventKind::Span});
+}
+
+void recordCounter(const char* name, std::int64_t value) {
+    record({name, nowNs(), 0, value, EventKind::Counter});
+}
+
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    std::uint64_t overwritten = 0;
+    for (const auto& buffer : snapshotBuffers()) {
+        for (const Event& event : snapshotEvents(*buffer, overwritten)) {
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            first = false;
+            writeJsonString(out, event.name);
+            out << ",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << event.start_ns / 1000.0;
+            if (event.kind == EventKind::Span) {
+                out << ",\"ph\":\"X\",\"dur\":" << event.duration_ns / 1000.0 << '}';
+            } else {
+                out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+            }
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+void writeSummary(std::ostream& out) {
+    std::map<std::string, SpanStats> spans;
+    std::map<std::string, CounterStats> counters;
+    std::uint64_t overwritten = 0;
+
+    for (const auto& buffer : snapshotBuffers()) {
+        for (const Event& event : snapshotEvents(*buffer, overwritten)) {
+            if (event.kind == EventKind::Span) {
+                SpanStats& stats = spans[event.name];
+                ++stats.count;
+                stats.total_ns += event.duration_ns;
+                stats.max_ns = std::max(stats.max_ns, event.duration_ns);
+                ++stats.histogram[bucketOf(event.duration_ns)];
+            } else {
+                CounterStats& stats = counters[event.name];
+                stats.max = stats.count == 0 ? event.value : std::max(stats.max, event.value);
+                ++stats.count;
+                stats.sum += event.value;
+            }
+        }
+    }
+
+    out << std::left << std::setw(40) << "span" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "total"
+        << std::setw(12) << "p50" << std::setw(12) << "p90"
+        << std::setw(12) << "p99" << std::setw(12) << "max" << '\n';
+    for (const auto& [name, stats] : spans) {
+        out << std::left << std::setw(40) << name << std::right
+            << std::setw(10) << stats.count << std::setw(12) << formatNs(stats.total_ns)
+            << std::setw(12) << formatNs(stats.percentile(0.5))
+            << std::setw(12) << formatNs(stats.percentile(0.9))
+            << std::setw(12) << formatNs(stats.percentile(0.99))
+            << std::setw(12) << formatNs(stats.max_ns) << '\n';
+    }
+
+    if (!counters.empty()) {
+        out << '\n' << std::left << std::setw(40) << "counter" << std::right
+            << std::setw(10) << "count" << std::setw(16) << "sum" << std::setw(16) << "max" << '\n';
+        for (const auto& [name, stats] : counters) {
+            out << std::left << std::setw(40) << name << std::right
+                << std::setw(10) << stats.count << std::setw(16) << stats.sum
+                << std::setw(16) << stats.max << '\n';
+        }
+    }
+
+    if (overwritten > 0) {
+        out << "\n以上只统计最近的事件，已被覆盖的较早事件数: " << overwritten << '\n';
+    }
+}
+
+} // namespace Trace
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 热路径追踪：作用域耗时和计数器记录到每线程的无锁环形缓冲区(保留最近的事件)，
+// 可导出为Chrome/Perfetto trace JSON，或输出各阶段的耗时直方图摘要。
+// 只有定义FILESERVER_ENABLE_TRACING时宏才会展开，否则完全编译掉。
+namespace Trace {
+
+// 单调时钟，纳秒
+std::uint64_t nowNs();
+
+// 记录一段耗时，name必须是静态字符串
+void recordSpan(const char* name, std::uint64_t start_ns, std::uint64_t end_ns);
+// 记录计数器的当前值
+void recordCounter(const char* name, std::int64_t value);
+
+// 导出各线程缓冲区中最近的事件；已退出的线程只保留最近退出的16个
+bool writeChromeTrace(const std::string& path);
+void writeSummary(std::ostream& out);
+
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char* name) : name_(name), start_ns_(nowNs()) {}
+    ~ScopedSpan() { recordSpan(name_, start_ns_, nowNs()); }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    const char* name_;
+    std::uint64_t start_ns_;
+};
+
+} // namespace Trace
+
+#define FS_TRACE_CONCAT_IMPL(a, b) a##b
+#define FS_TRACE_CONCAT(a, b) FS_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef FILESERVER_ENABLE_TRACING
+    #define FS_TRACE_SCOPE(name) ::Trace::ScopedSpan FS_TRACE_CONCAT(fs_trace_span_, __LINE__)(name)
+    #define FS_TRACE_SPAN(name, start_ns, end_ns) ::Trace::recordSpan((name), (start_ns), (end_ns))
+    #define FS_TRACE_COUNTER(name, value) ::Trace::recordCounter((name), static_cast<std::int64_t>(value))
+    #define FS_TRACE_NOW() ::Trace::nowNs()
+#else
+    #define FS_TRACE_SCOPE(name) ((void)0)
+    #define FS_TRACE_SPAN(name, start_ns, end_ns) ((void)0)
+    #define FS_TRACE_COUNTER(name, value) ((void)0)
+    #define FS_TRACE_NOW() std::uint64_t(0)
+#endif
@@ -1,4 +1,5 @@
 #include "FileServer.h"
+#include "Trace.h"
 #include <iostream>
 #include <locale>
 #include <codecvt>
@@ -53,10 +54,57 @@ int main() {
             std::cout << "文件删除成功！" << std::endl;
         }
         
+        // 测试批量操作
+        std::vector<FileServer::UploadItem> batch = {
+            {"batch_a.txt", {'A'}},
+            {"batch_b.txt", {'B'}},
+        };
+        auto upload_results = server.uploadBatch(batch);
+        std::cout << "批量上传：" << upload_results.size() << " 个文件" << std::endl;
+        auto stats = server.statBatch({"batch_a.txt", "batch_b.txt", "missing.txt"});
+        for (const auto& stat : stats) {
+            if (stat.result.code == FileServer::ErrorCode::SUCCESS) {
+                std::cout << "批量查询：" << stat.size << " 字节" << std::endl;
+            } else {
+                std::cout << "批量查询失败：" << stat.result.message << std::endl;
+            }
+        }
+        server.deleteBatch({"batch_a.txt", "batch_b.txt"});
+        
+        // 测试静态压缩和范围读取
+        server.setCompressionEnabled(true);
+        std::string log_line = "2024-01-01 12:00:00,INFO,request served\n";
+        std::vector<char> log_data;
+        for (int i = 0; i < 20000; ++i) {
+            log_data.insert(log_data.end(), log_line.begin(), log_line.end());
+        }
+        if (server.uploadFile("access.csv", log_data)) {
+            auto range = server.downloadRange("access.csv", log_line.size(), log_line.size());
+            auto stats = server.fileCompressionStats("access.csv");
+            std::cout << "压缩比：" << stats.ratio() << "，范围读取："
+                      << std::string(range.begin(), range.end());
+            server.deleteFile("access.csv");
+        }
+        server.setCompressionEnabled(false);
+        
+        // 测试异步接口(同步等待)
+        auto async_result = syncWait(server.uploadAsync("async.txt", {'O', 'K'}));
+        if (async_result.code == FileServer::ErrorCode::SUCCESS) {
+            auto async_data = syncWait(server.downloadAsync("async.txt"));
+            std::cout << "异步下载：" << async_data.data.size() << " 字节" << std::endl;
+            syncWait(server.deleteAsync("async.txt"));
+        }
+        
     } catch (const std::exception& e) {
         std::cerr << "错误：" << e.what() << std::endl;
         return 1;
     }
     
+    #ifdef FILESERVER_ENABLE_TRACING
+        // 导出追踪数据，可在chrome://tracing或Perfetto中打开
+        Trace::writeChromeTrace("fileserver_trace.json");
+        Trace::writeSummary(std::cout);
+    #endif
+    
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include <QByteArray>
+#include <QtEndian>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// 传输协议v2：每个帧由16字节定长小端帧头和负载组成。
+// 帧头携带流编号，多个文件的数据和控制消息可以在同一连接上交错传输。
+// v1协议(QDataStream文件头 + 原始数据)的连接以文件大小开头，
+// 前4字节不可能等于Magic，服务端据此区分两种协议。
+namespace WireProtocol {
+
+constexpr quint32 Magic = 0x32505346;  // 字节序列 "FSP2"
+constexpr quint8 Version = 2;
+constexpr quint32 ControlStreamId = 0;
+constexpr quint32 MaxPayloadSize = 1024 * 1024;
+constexpr quint16 FlagMore = 0x0001;    // 消息被拆分为多个帧，后面还有后续帧
+constexpr quint16 FlagResume = 0x0002;  // FileOpen：请求续传，等待FileAccept后再发送数据
+
+enum class FrameType : quint8 {
+    Hello = 1,          // 连接建立后首先发送
+    FileOpen = 2,       // 开始文件流，负载为FileOpenPayload + UTF-8文件名
+    FileData = 3,       // 文件数据
+    FileClose = 4,      // 文件数据发送完毕
+    Ack = 5,            // 确认，负载为AckPayload
+    Cancel = 6,         // 取消文件流
+    ListRequest = 7,    // 请求文件列表(只包含服务器接收的文件)
+    ListResponse = 8,   // 文件列表，UTF-8文件名以'\n'分隔
+    DeleteRequest = 9,  // 删除服务器接收的文件，负载为UTF-8文件名
+    Error = 10,         // 错误，负载为UTF-8错误信息
+    FileAccept = 11     // 回应带FlagResume的FileOpen，负载为AckPayload(续传起始偏移)
+};
+
+struct FrameHeader {
+    quint32 magic;
+    quint8 version;
+    quint8 type;
+    quint16 flags;
+    quint32 streamId;
+    quint32 payloadSize;
+};
+
+struct FileOpenPayload {
+    quint64 fileSize;
+    quint32 nameSize;
+    quint32 reserved;
+    quint64 fingerprint;  // 源文件指纹，续传时确认是同一个文件；0表示未知，不续传
+};
+
+struct AckPayload {
+    quint64 bytes;
+    quint32 status;
+    quint32 reserved;
+};
+
+// 线上布局在编译期固定，帧头和负载可以直接从接收缓冲区按偏移读取
+static_assert(std::is_trivially_copyable_v<FrameHeader>);
+static_assert(sizeof(FrameHeader) == 16);
+static_assert(offsetof(FrameHeader, magic) == 0);
+static_assert(offsetof(FrameHeader, version) == 4);
+static_assert(offsetof(FrameHeader, type) == 5);
+static_assert(offsetof(FrameHeader, flags) == 6);
+static_assert(offsetof(FrameHeader, streamId) == 8);
+static_assert(offsetof(FrameHeader, payloadSize) == 12);
+static_assert(std::is_trivially_copyable_v<FileOpenPayload>);
+static_assert(sizeof(FileOpenPayload) == 24);
+static_assert(offsetof(FileOpenPayload, nameSize) == 8);
+static_assert(offsetof(FileOpenPayload, fingerprint) == 16);
+static_assert(std::is_trivially_copyable_v<AckPayload>);
+static_assert(sizeof(AckPayload) == 16);
+static_assert(offsetof(AckPayload, status) == 8);
+
+constexpr qsizetype HeaderSize = sizeof(FrameHeader);
+
+inline bool isV2Stream(const QByteArray &data) {
+    return data.size() >= qsizetype(sizeof(quint32))
+        && qFromLittleEndian<quint32>(data.constData()) == Magic;
+}
+
+// 生成线上字节序的帧头
+inline FrameHeader makeHeader(FrameType type, quint32 streamId, quint32 payloadSize, quint16 flags = 0) {
+    FrameHeader header;
+    header.magic = qToLittleEndian(Magic);
+    header.version = Version;
+    header.type = static_cast<quint8>(type);
+    header.flags = qToLittleEndian(flags);
+    header.streamId = qToLittleEndian(streamId);
+    header.payloadSize = qToLittleEndian(payloadSize);
+    return header;
+}
+
+// 从data处读取帧头并转换为本机字节序
+inline FrameHeader readHeader(const char *data) {
+    FrameHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    header.magic = qFromLittleEndian(header.magic);
+    header.flags = qFromLittleEndian(header.flags);
+    header.streamId = qFromLittleEndian(header.streamId);
+    header.payloadSize = qFromLittleEndian(header.payloadSize);
+    return header;
+}
+
+inline bool isValidHeader(const FrameHeader &header) {
+    return header.magic == Magic && header.version == Version
+        && header.payloadSize <= MaxPayloadSize;
+}
+
+inline FileOpenPayload readFileOpen(const char *data) {
+    FileOpenPayload payload;
+    std::memcpy(&payload, data, sizeof(payload));
+    payload.fileSize = qFromLittleEndian(payload.fileSize);
+    payload.nameSize = qFromLittleEndian(payload.nameSize);
+    payload.fingerprint = qFromLittleEndian(payload.fingerprint);
+    return payload;
+}
+
+inline AckPayload readAck(const char *data) {
+    AckPayload payload;
+    std::memcpy(&payload, data, sizeof(payload));
+    payload.bytes = qFromLittleEndian(payload.bytes);
+    payload.status = qFromLittleEndian(payload.status);
+    return payload;
+}
+
+// 编码一个完整的帧
+inline QByteArray encodeFrame(FrameType type, quint32 streamId,
+                              const char *payload = nullptr, quint32 payloadSize = 0,
+                              quint16 flags = 0) {
+    FrameHeader header = makeHeader(type, streamId, payloadSize, flags);
+    QByteArray frame;
+    frame.reserve(HeaderSize + payloadSize);
+    frame.append(reinterpret_cast<const char *>(&header), HeaderSize);
+    if (payloadSize > 0) {
+        frame.append(payload, payloadSize);
+    }
+    return frame;
+}
+
+inline QByteArray encodeFrame(FrameType type, quint32 streamId, const QByteArray &payload,
+                              quint16 flags = 0) {
+    return encodeFrame(type, streamId, payload.constData(), quint32(payload.size()), flags);
+}
+
+inline QByteArray encodeFileOpen(quint32 streamId, qint64 fileSize, const QByteArray &fileName,
+                                 quint16 flags = 0, quint64 fingerprint = 0) {
+    FileOpenPayload open;
+    open.fileSize = qToLittleEndian(quint64(fileSize));
+    open.nameSize = qToLittleEndian(quint32(fileName.size()));
+    open.reserved = 0;
+    open.fingerprint = qToLittleEndian(fingerprint);
+
+    QByteArray payload(reinterpret_cast<const char *>(&open), sizeof(open));
+    payload.append(fileName);
+    return encodeFrame(FrameType::FileOpen, streamId, payload, flags);
+}
+
+inline QByteArray encodeAck(quint32 streamId, qint64 bytes, quint32 status = 0,
+                            FrameType type = FrameType::Ack) {
+    AckPayload ack;
+    ack.bytes = qToLittleEndian(quint64(bytes));
+    ack.status = qToLittleEndian(status);
+    ack.reserved = 0;
+    return encodeFrame(type, streamId,
+                       reinterpret_cast<const char *>(&ack), sizeof(ack));
+}
+
+inline QByteArray encodeFileAccept(quint32 streamId, qint64 offset) {
+    return encodeAck(streamId, offset, 0, FrameType::FileAccept);
+}
+
+} // namespace WireProtocol
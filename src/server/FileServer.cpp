@@ -1,26 +1,41 @@
 #include "FileServer.h"
+#include "../Trace.h"
 #include <QDir>
 #include <QDateTime>
 #include <QStandardPaths>
 #include <QNetworkInterface>
 
+namespace {
+const qint64 checkpointInterval = 4 * 1024 * 1024;               // 每接收4MB记录一次检查点
+const qint64 journalRetentionMs = 7LL * 24 * 60 * 60 * 1000;     // 未完成传输保留7天
+const qint64 socketReadBufferSize = 4 * 1024 * 1024;             // 套接字读缓冲区上限，满后由TCP流控限速
+const char journalFileName[] = ".transfer_journal";
+}
+
 FileServer::FileServer(QObject *parent) 
     : QObject(parent)
     , server(new QTcpServer(this))
     , clientSocket(nullptr)
     , currentFile(nullptr)
+    , journal(nullptr)
     , transferState(TransferState::WaitingHeader)
+    , protocolVersion(ProtocolVersion::Unknown)
+    , processingFrames(false)
     , fileSize(0)
-    , receivedSize(0) {
+    , receivedSize(0)
+    , currentJournalId(0)
+    , lastCheckpointSize(0) {
     
     // 设置默认保存目录为下载文件夹
     saveDirectory = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
     QDir().mkpath(saveDirectory);
+    journal = new TransferJournal(QDir(saveDirectory).filePath(journalFileName));
 }
 
 FileServer::~FileServer() {
     stopServer();
     delete currentFile;
+    delete journal;
 }
 
 bool FileServer::startServer(quint16 port) {
@@ -28,6 +43,15 @@ bool FileServer::startServer(quint16 port) {
         return true;
     }
     
+    // 重放传输日志，恢复上次未完成的传输
+    if (!journal->isOpen()) {
+        if (journal->open()) {
+            recoverInterruptedTransfers();
+        } else {
+            emit error(tr("无法打开传输日志"));
+        }
+    }
+    
     return server->listen(QHostAddress::Any, port);
 }
 
@@ -43,6 +67,8 @@ void FileServer::stopServer() {
     }
     
     resetTransferState();
+    // 下次启动时重新重放日志，本次中断的传输也会被恢复或清理
+    journal->close();
 }
 
 QString FileServer::getServerAddress() const {
@@ -64,6 +90,7 @@ void FileServer::handleNewConnection() {
     }
     
     clientSocket = server->nextPendingConnection();
+    clientSocket->setReadBufferSize(socketReadBufferSize);
     
     connect(clientSocket, &QTcpSocket::readyRead,
             this, &FileServer::handleReadyRead);
@@ -77,7 +104,31 @@ void FileServer::handleNewConnection() {
 }
 
 void FileServer::handleReadyRead() {
-    buffer.append(clientSocket->readAll());
+    FS_TRACE_SCOPE("FileServer::handleReadyRead");
+    // 帧处理中进入了嵌套事件循环，此时不读取套接字：数据留在有上限的读缓冲区中，
+    // 缓冲区满后发送方被TCP流控阻塞，外层处理结束后再继续读取
+    if (processingFrames) {
+        return;
+    }
+    {
+        FS_TRACE_SCOPE("FileServer::socketRead");
+        buffer.append(clientSocket->readAll());
+    }
+    FS_TRACE_COUNTER("FileServer::bufferedBytes", buffer.size());
+    
+    if (protocolVersion == ProtocolVersion::Unknown) {
+        // 根据前4字节区分v1与v2客户端
+        if (buffer.size() < qsizetype(sizeof(quint32))) {
+            return;
+        }
+        protocolVersion = WireProtocol::isV2Stream(buffer)
+            ? ProtocolVersion::V2 : ProtocolVersion::V1;
+    }
+    
+    if (protocolVersion == ProtocolVersion::V2) {
+        processFrames();
+        return;
+    }
     
     switch (transferState) {
         case TransferState::WaitingHeader:
@@ -118,11 +169,13 @@ void FileServer::processFileHeader() {
         resetTransferState();
         return;
     }
+    currentJournalId = journal->recordStart(currentFileName, savePath, fileSize);
+    lastCheckpointSize = 0;
     
     // 更新状态
     buffer = buffer.mid(sizeof(qint64) + sizeof(qint32) + fileNameSize);
     transferState = TransferState::ReceivingFile;
-    emit fileReceiveStarted(currentFileName, fileSize);
+    emit fileReceiveStarted(0, currentFileName, fileSize);
     
     // 如果buffer中还有数据，继续处理
     if (!buffer.isEmpty()) {
@@ -137,7 +190,11 @@ void FileServer::processFileData() {
     }
     
     // 写入数据
-    qint64 written = currentFile->write(buffer);
+    qint64 written;
+    {
+        FS_TRACE_SCOPE("FileServer::fileWrite");
+        written = currentFile->write(buffer);
+    }
     if (written == -1) {
         emit error(tr("写入文件失败: %1").arg(currentFile->errorString()));
         resetTransferState();
@@ -146,13 +203,22 @@ void FileServer::processFileData() {
     
     receivedSize += written;
     buffer.clear();
+    writeCheckpoint(currentFile, currentJournalId, receivedSize, lastCheckpointSize, false);
     
-    emit fileReceiveProgress(receivedSize);
+    emit fileReceiveProgress(0, receivedSize);
     
     // 检查是否接收完成
     if (receivedSize >= fileSize) {
+        // 数据落盘之后才能记录完成，否则断电后日志中已没有记录而文件却不完整
+        if (!TransferJournal::syncFile(*currentFile)) {
+            emit error(tr("同步文件失败: %1").arg(currentFile->errorString()));
+            resetTransferState();
+            return;
+        }
         currentFile->close();
-        emit fileReceiveCompleted();
+        journal->recordComplete(currentJournalId);
+        currentJournalId = 0;
+        emit fileReceiveCompleted(0, currentFileName);
         resetTransferState();
     }
 }
@@ -171,14 +237,25 @@ void FileServer::handleError(QAbstractSocket::SocketError socketError) {
 
 void FileServer::resetTransferState() {
     if (currentFile) {
+        // 未完成的传输记录最终检查点，重启后可以续传
+        if (currentJournalId != 0) {
+            writeCheckpoint(currentFile, currentJournalId, receivedSize, lastCheckpointSize, true);
+        }
         currentFile->close();
         delete currentFile;
         currentFile = nullptr;
+        if (currentJournalId != 0) {
+            journal->release(currentJournalId);
+        }
     }
+    closeStreams();
     
     transferState = TransferState::WaitingHeader;
+    protocolVersion = ProtocolVersion::Unknown;
     fileSize = 0;
     receivedSize = 0;
+    currentJournalId = 0;
+    lastCheckpointSize = 0;
     currentFileName.clear();
     buffer.clear();
 }
@@ -189,4 +266,331 @@ QString FileServer::getSaveFilePath(const QString &fileName) {
     QString dateTime = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
     QString newFileName = QString("%1_%2.%3").arg(baseName, dateTime, extension);
     return QDir(saveDirectory).filePath(newFileName);
-} 
\ No newline at end of file
+}
+
+void FileServer::processFrames() {
+    // 信号处理中可能进入嵌套事件循环，防止重入
+    if (processingFrames) {
+        return;
+    }
+    processingFrames = true;
+    
+    // 帧头和负载直接从接收缓冲区按偏移读取，处理完后一次性移除已消费的数据
+    qsizetype offset = 0;
+    while (clientSocket && buffer.size() - offset >= WireProtocol::HeaderSize) {
+        const WireProtocol::FrameHeader header = WireProtocol::readHeader(buffer.constData() + offset);
+        if (!WireProtocol::isValidHeader(header)) {
+            processingFrames = false;
+            emit error(tr("收到无效的数据帧"));
+            clientSocket->abort();
+            return;
+        }
+        
+        qsizetype frameSize = WireProtocol::HeaderSize + header.payloadSize;
+        if (buffer.size() - offset < frameSize) {
+            break;
+        }
+        
+        handleFrame(header, buffer.constData() + offset + WireProtocol::HeaderSize);
+        offset += frameSize;
+    }
+    buffer.remove(0, offset);
+    processingFrames = false;
+    
+    // 处理期间被跳过的数据不会再触发readyRead，排队继续读取
+    if (clientSocket && clientSocket->bytesAvailable() > 0) {
+        QMetaObject::invokeMethod(this, &FileServer::handleReadyRead, Qt::QueuedConnection);
+    }
+}
+
+void FileServer::handleFrame(const WireProtocol::FrameHeader &header, const char *payload) {
+    using WireProtocol::FrameType;
+    
+    switch (static_cast<FrameType>(header.type)) {
+        case FrameType::Hello:
+            sendFrame(WireProtocol::encodeFrame(FrameType::Hello, WireProtocol::ControlStreamId));
+            break;
+        case FrameType::FileOpen:
+            handleFileOpen(header.streamId, header.flags, payload, header.payloadSize);
+            break;
+        case FrameType::FileData:
+            handleFileData(header.streamId, payload, header.payloadSize);
+            break;
+        case FrameType::FileClose:
+            handleFileClose(header.streamId);
+            break;
+        case FrameType::Cancel:
+            handleCancel(header.streamId);
+            break;
+        case FrameType::ListRequest:
+            handleListRequest(header.streamId);
+            break;
+        case FrameType::DeleteRequest:
+            handleDeleteRequest(header.streamId, payload, header.payloadSize);
+            break;
+        default:
+            sendError(header.streamId, tr("不支持的帧类型: %1").arg(uint(header.type)));
+            break;
+    }
+}
+
+void FileServer::handleFileOpen(quint32 streamId, quint16 flags, const char *payload, quint32 size) {
+    if (size < sizeof(WireProtocol::FileOpenPayload)) {
+        sendError(streamId, tr("文件头不完整"));
+        return;
+    }
+    
+    const WireProtocol::FileOpenPayload open = WireProtocol::readFileOpen(payload);
+    if (open.nameSize > size - sizeof(WireProtocol::FileOpenPayload)) {
+        sendError(streamId, tr("文件名长度无效"));
+        return;
+    }
+    if (streams.contains(streamId)) {
+        sendError(streamId, tr("流编号已被使用: %1").arg(streamId));
+        return;
+    }
+    
+    QString fileName = QString::fromUtf8(payload + sizeof(WireProtocol::FileOpenPayload), open.nameSize);
+    qint64 totalSize = qint64(open.fileSize);
+    
+    // 请求续传时，查找日志中同名、同大小且源文件指纹一致的未完成传输
+    bool resumeRequested = flags & WireProtocol::FlagResume;
+    TransferJournal::Entry resumed;
+    bool resuming = resumeRequested
+        && journal->takeResumable(fileName, totalSize, open.fingerprint, resumed);
+    QFile *file = nullptr;
+    if (resuming) {
+        // 部分文件可能在启动之后被删除或截断，此时不能从检查点续传，改为重新接收。
+        // ExistingOnly避免为已删除的部分文件创建一个空文件
+        file = new QFile(resumed.savePath);
+        if (!file->open(QIODevice::ReadWrite | QIODevice::ExistingOnly)
+            || file->size() < resumed.receivedBytes) {
+            delete file;
+            file = nullptr;
+            QFile::remove(resumed.savePath);
+            journal->recordAbort(resumed.id);
+            resuming = false;
+        }
+    }
+    
+    QString savePath = resuming ? resumed.savePath : getSaveFilePath(fileName);
+    if (!file) {
+        file = new QFile(savePath);
+        if (!file->open(QIODevice::WriteOnly)) {
+            delete file;
+            emit error(tr("无法创建文件: %1").arg(savePath));
+            sendError(streamId, tr("无法创建文件: %1").arg(fileName));
+            return;
+        }
+    }
+    
+    // 检查点之后写入的数据未被确认，从检查点处继续
+    qint64 offset = 0;
+    quint64 journalId;
+    if (resuming) {
+        offset = resumed.receivedBytes;
+        file->resize(offset);
+        file->seek(offset);
+        journalId = resumed.id;
+    } else {
+        journalId = journal->recordStart(fileName, savePath, totalSize, open.fingerprint);
+    }
+    
+    streams.insert(streamId, IncomingStream{file, fileName, totalSize, offset, journalId, offset});
+    if (resumeRequested) {
+        sendFrame(WireProtocol::encodeFileAccept(streamId, offset));
+    }
+    emit fileReceiveStarted(streamId, fileName, totalSize);
+}
+
+void FileServer::handleFileData(quint32 streamId, const char *payload, quint32 size) {
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        // 已取消或出错的流可能还有在途数据，直接丢弃
+        return;
+    }
+    
+    qint64 written;
+    {
+        FS_TRACE_SCOPE("FileServer::fileWrite");
+        written = it->file->write(payload, size);
+    }
+    if (written != qint64(size)) {
+        emit error(tr("写入文件失败: %1").arg(it->file->errorString()));
+        sendError(streamId, tr("写入文件失败"));
+        writeCheckpoint(it->file, it->journalId, it->receivedSize, it->lastCheckpoint, true);
+        it->file->close();
+        delete it->file;
+        journal->release(it->journalId);
+        streams.erase(it);
+        return;
+    }
+    
+    it->receivedSize += written;
+    writeCheckpoint(it->file, it->journalId, it->receivedSize, it->lastCheckpoint, false);
+    emit fileReceiveProgress(streamId, it->receivedSize);
+}
+
+void FileServer::handleFileClose(quint32 streamId) {
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
+    }
+    
+    IncomingStream stream = *it;
+    streams.erase(it);
+    
+    // 数据落盘之后才能记录完成，同步失败时按未完成处理
+    bool synced = stream.receivedSize == stream.fileSize && TransferJournal::syncFile(*stream.file);
+    if (!synced) {
+        // 保留在日志中，之后可以续传
+        writeCheckpoint(stream.file, stream.journalId, stream.receivedSize, stream.lastCheckpoint, true);
+        stream.file->close();
+        delete stream.file;
+        journal->release(stream.journalId);
+        emit error(tr("文件接收不完整: %1").arg(stream.fileName));
+        sendFrame(WireProtocol::encodeAck(streamId, stream.receivedSize, 1));
+        return;
+    }
+    
+    stream.file->close();
+    delete stream.file;
+    journal->recordComplete(stream.journalId);
+    sendFrame(WireProtocol::encodeAck(streamId, stream.receivedSize));
+    emit fileReceiveCompleted(streamId, stream.fileName);
+}
+
+void FileServer::handleCancel(quint32 streamId) {
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
+    }
+    
+    // 取消的文件不保留部分数据
+    it->file->close();
+    it->file->remove();
+    delete it->file;
+    journal->recordAbort(it->journalId);
+    streams.erase(it);
+}
+
+void FileServer::handleListRequest(quint32 streamId) {
+    // 只列出本服务器接收的文件，不暴露保存目录中的其他文件
+    QStringList files;
+    for (const QString &savePath : journal->receivedFiles()) {
+        QFileInfo info(savePath);
+        if (info.isFile()) {
+            files.append(info.fileName());
+        }
+    }
+    files.sort();
+    QByteArray list = files.join('\n').toUtf8();
+    
+    // 超过单帧上限的列表拆分为多个帧发送
+    qsizetype offset = 0;
+    do {
+        qsizetype chunk = qMin<qsizetype>(list.size() - offset, WireProtocol::MaxPayloadSize);
+        bool more = offset + chunk < list.size();
+        sendFrame(WireProtocol::encodeFrame(WireProtocol::FrameType::ListResponse, streamId,
+                                            list.constData() + offset, quint32(chunk),
+                                            more ? WireProtocol::FlagMore : 0));
+        offset += chunk;
+    } while (offset < list.size());
+}
+
+void FileServer::handleDeleteRequest(quint32 streamId, const char *payload, quint32 size) {
+    // 只允许删除本服务器接收的文件
+    QString fileName = QString::fromUtf8(payload, size);
+    if (fileName.isEmpty() || QFileInfo(fileName).fileName() != fileName
+        || fileName == "." || fileName == "..") {
+        sendError(streamId, tr("无效的文件名: %1").arg(fileName));
+        return;
+    }
+    
+    // 传输日志、其他文件和未接收完成的文件都不在已接收列表中
+    QString filePath = QDir(saveDirectory).filePath(fileName);
+    if (!journal->isReceivedFile(filePath)) {
+        sendError(streamId, tr("文件不存在: %1").arg(fileName));
+        return;
+    }
+    if (isReceiving(filePath)) {
+        sendError(streamId, tr("文件正在使用: %1").arg(fileName));
+        return;
+    }
+    
+    if (!QFile::remove(filePath)) {
+        sendError(streamId, tr("无法删除文件: %1").arg(fileName));
+        return;
+    }
+    journal->forgetReceived(filePath);
+    sendFrame(WireProtocol::encodeAck(streamId, 0));
+}
+
+bool FileServer::isReceiving(const QString &filePath) const {
+    const QString target = QFileInfo(filePath).absoluteFilePath();
+    if (currentFile && QFileInfo(*currentFile).absoluteFilePath() == target) {
+        return true;
+    }
+    for (const IncomingStream &stream : streams) {
+        if (QFileInfo(*stream.file).absoluteFilePath() == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FileServer::sendFrame(const QByteArray &frame) {
+    if (clientSocket) {
+        clientSocket->write(frame);
+    }
+}
+
+void FileServer::sendError(quint32 streamId, const QString &message) {
+    sendFrame(WireProtocol::encodeFrame(WireProtocol::FrameType::Error, streamId, message.toUtf8()));
+}
+
+void FileServer::closeStreams() {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        writeCheckpoint(it->file, it->journalId, it->receivedSize, it->lastCheckpoint, true);
+        it->file->close();
+        delete it->file;
+        journal->release(it->journalId);
+    }
+    streams.clear();
+}
+
+void FileServer::recoverInterruptedTransfers() {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int resumable = 0;
+    
+    for (const TransferJournal::Entry &entry : journal->interruptedTransfers()) {
+        // 没有指纹(v1或未请求续传)、部分文件已丢失、比检查点短或已过期的传输直接清理
+        QFileInfo info(entry.savePath);
+        if (entry.fingerprint == 0 || !info.exists() || info.size() < entry.receivedBytes
+            || now - entry.startedAt > journalRetentionMs) {
+            QFile::remove(entry.savePath);
+            journal->recordAbort(entry.id);
+            continue;
+        }
+        ++resumable;
+    }
+    
+    if (resumable > 0) {
+        emit interruptedTransfersRecovered(resumable);
+    }
+}
+
+void FileServer::writeCheckpoint(QFile *file, quint64 journalId, qint64 received,
+                                 qint64 &lastCheckpoint, bool force) {
+    if (!force && received - lastCheckpoint < checkpointInterval) {
+        return;
+    }
+    
+    // 先把数据同步到磁盘，再记录检查点，保证断电后检查点之前的数据也已落盘
+    if (!TransferJournal::syncFile(*file)) {
+        emit error(tr("同步文件失败: %1").arg(file->errorString()));
+        return;
+    }
+    journal->recordCheckpoint(journalId, received);
+    lastCheckpoint = received;
+}
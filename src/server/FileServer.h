@@ -3,6 +3,9 @@
 #include <QTcpSocket>
 #include <QString>
 #include <QFile>
+#include <QHash>
+#include "../protocol/WireProtocol.h"
+#include "TransferJournal.h"
 
 class FileServer : public QObject {
     Q_OBJECT
@@ -16,9 +19,11 @@ public:
 signals:
     void clientConnected(const QString &clientAddress);
     void clientDisconnected();
-    void fileReceiveStarted(const QString &fileName, qint64 fileSize);
-    void fileReceiveProgress(qint64 bytesReceived);
-    void fileReceiveCompleted();
+    // streamId区分同一连接上交错传输的文件，v1连接固定为0(v2的0号是控制流，不会用于文件)
+    void fileReceiveStarted(quint32 streamId, const QString &fileName, qint64 fileSize);
+    void fileReceiveProgress(quint32 streamId, qint64 bytesReceived);
+    void fileReceiveCompleted(quint32 streamId, const QString &fileName);
+    void interruptedTransfersRecovered(int count);
     void error(const QString &errorMessage);
 
 private slots:
@@ -33,9 +38,29 @@ private:
     void processFileData();
     QString getSaveFilePath(const QString &fileName);
 
+    // v2协议处理
+    void processFrames();
+    void handleFrame(const WireProtocol::FrameHeader &header, const char *payload);
+    void handleFileOpen(quint32 streamId, quint16 flags, const char *payload, quint32 size);
+    void handleFileData(quint32 streamId, const char *payload, quint32 size);
+    void handleFileClose(quint32 streamId);
+    void handleCancel(quint32 streamId);
+    void handleListRequest(quint32 streamId);
+    void handleDeleteRequest(quint32 streamId, const char *payload, quint32 size);
+    bool isReceiving(const QString &filePath) const;
+    void sendFrame(const QByteArray &frame);
+    void sendError(quint32 streamId, const QString &message);
+    void closeStreams();
+    
+    // 传输日志
+    void recoverInterruptedTransfers();
+    void writeCheckpoint(QFile *file, quint64 journalId, qint64 received,
+                         qint64 &lastCheckpoint, bool force);
+
     QTcpServer *server;
     QTcpSocket *clientSocket;
     QFile *currentFile;
+    TransferJournal *journal;
     
     // 传输状态
     enum class TransferState {
@@ -44,9 +69,30 @@ private:
         ReceivingFile
     };
     
+    enum class ProtocolVersion {
+        Unknown,
+        V1,
+        V2
+    };
+    
+    // v2协议中一个正在接收的文件流
+    struct IncomingStream {
+        QFile *file;
+        QString fileName;
+        qint64 fileSize;
+        qint64 receivedSize;
+        quint64 journalId;
+        qint64 lastCheckpoint;
+    };
+    
     TransferState transferState;
+    ProtocolVersion protocolVersion;
+    QHash<quint32, IncomingStream> streams;
+    bool processingFrames;
     qint64 fileSize;
     qint64 receivedSize;
+    quint64 currentJournalId;
+    qint64 lastCheckpointSize;
     QString currentFileName;
     QByteArray buffer;
     QString saveDirectory;
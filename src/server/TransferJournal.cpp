@@ -0,0 +1,304 @@
+#include "TransferJournal.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+    #include <io.h>
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+TransferJournal::TransferJournal(const QString &path)
+    : journalPath(path)
+    , nextId(1) {
+}
+
+TransferJournal::~TransferJournal() {
+    close();
+}
+
+bool TransferJournal::open() {
+    if (file.isOpen()) {
+        return true;
+    }
+    
+    entries.clear();
+    activeIds.clear();
+    receivedPaths.clear();
+    
+    QFile existing(journalPath);
+    if (existing.open(QIODevice::ReadOnly)) {
+        replay(existing.readAll());
+        existing.close();
+    }
+    
+    // 只保留未完成的传输和仍然存在的已接收文件
+    if (!compact()) {
+        return false;
+    }
+    
+    file.setFileName(journalPath);
+    return file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void TransferJournal::close() {
+    if (file.isOpen()) {
+        file.close();
+    }
+    activeIds.clear();
+}
+
+bool TransferJournal::isOpen() const {
+    return file.isOpen();
+}
+
+quint64 TransferJournal::recordStart(const QString &fileName, const QString &savePath, qint64 fileSize,
+                                     quint64 fingerprint) {
+    Entry entry{nextId++, fileName, savePath, fileSize, 0, QDateTime::currentMSecsSinceEpoch(), fingerprint};
+    entries.insert(entry.id, entry);
+    activeIds.insert(entry.id);
+    
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RecordType::Start) << entry.id << entry.fileName << entry.savePath
+        << entry.fileSize << entry.startedAt << entry.fingerprint;
+    append(payload);
+    return entry.id;
+}
+
+void TransferJournal::recordCheckpoint(quint64 id, qint64 receivedBytes) {
+    auto it = entries.find(id);
+    if (it == entries.end() || it->receivedBytes == receivedBytes) {
+        return;
+    }
+    it->receivedBytes = receivedBytes;
+    
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RecordType::Checkpoint) << id << receivedBytes;
+    append(payload);
+}
+
+void TransferJournal::recordComplete(quint64 id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+    receivedPaths.insert(it->savePath);
+    entries.erase(it);
+    activeIds.remove(id);
+    
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RecordType::Complete) << id;
+    append(payload);
+}
+
+void TransferJournal::recordAbort(quint64 id) {
+    if (!entries.remove(id)) {
+        return;
+    }
+    activeIds.remove(id);
+    
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RecordType::Abort) << id;
+    append(payload);
+}
+
+void TransferJournal::release(quint64 id) {
+    activeIds.remove(id);
+    
+    // 没有指纹的传输永远不会被续传，保留部分文件只会留给用户手动清理
+    auto it = entries.find(id);
+    if (it != entries.end() && it->fingerprint == 0) {
+        QFile::remove(it->savePath);
+        recordAbort(id);
+    }
+}
+
+QList<TransferJournal::Entry> TransferJournal::interruptedTransfers() const {
+    QList<Entry> result;
+    for (const Entry &entry : entries) {
+        if (!activeIds.contains(entry.id)) {
+            result.append(entry);
+        }
+    }
+    return result;
+}
+
+QStringList TransferJournal::receivedFiles() const {
+    return QStringList(receivedPaths.cbegin(), receivedPaths.cend());
+}
+
+bool TransferJournal::isReceivedFile(const QString &savePath) const {
+    return receivedPaths.contains(savePath);
+}
+
+void TransferJournal::forgetReceived(const QString &savePath) {
+    if (!receivedPaths.remove(savePath)) {
+        return;
+    }
+    
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RecordType::Forget) << quint64(0) << savePath;
+    append(payload);
+}
+
+bool TransferJournal::takeResumable(const QString &fileName, qint64 fileSize, quint64 fingerprint,
+                                    Entry &entry) {
+    if (fingerprint == 0) {
+        return false;
+    }
+    for (const Entry &candidate : entries) {
+        if (!activeIds.contains(candidate.id) && candidate.fingerprint == fingerprint
+            && candidate.fileName == fileName && candidate.fileSize == fileSize) {
+            entry = candidate;
+            activeIds.insert(candidate.id);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransferJournal::replay(const QByteArray &data) {
+    const qsizetype recordHeaderSize = sizeof(quint32) + sizeof(quint16);
+    
+    qsizetype offset = 0;
+    while (data.size() - offset >= recordHeaderSize) {
+        QDataStream in(data.mid(offset, recordHeaderSize));
+        quint32 length;
+        quint16 checksum;
+        in >> length >> checksum;
+        
+        // 尾部记录不完整或校验失败，说明写入时发生了崩溃，之后的内容全部丢弃
+        if (data.size() - offset - recordHeaderSize < qsizetype(length)) {
+            break;
+        }
+        QByteArray payload = data.mid(offset + recordHeaderSize, length);
+        if (qChecksum(payload) != checksum) {
+            break;
+        }
+        
+        applyRecord(payload);
+        offset += recordHeaderSize + length;
+    }
+}
+
+void TransferJournal::applyRecord(const QByteArray &payload) {
+    QDataStream in(payload);
+    quint8 type;
+    quint64 id;
+    in >> type >> id;
+    nextId = qMax(nextId, id + 1);
+    
+    switch (static_cast<RecordType>(type)) {
+        case RecordType::Start: {
+            Entry entry{id, QString(), QString(), 0, 0, 0, 0};
+            in >> entry.fileName >> entry.savePath >> entry.fileSize >> entry.startedAt;
+            // 旧版本的记录没有指纹，读取失败时保持为0，这些传输不会被续传
+            if (!in.atEnd()) {
+                in >> entry.fingerprint;
+            }
+            entries.insert(id, entry);
+            break;
+        }
+        case RecordType::Checkpoint: {
+            qint64 receivedBytes;
+            in >> receivedBytes;
+            auto it = entries.find(id);
+            if (it != entries.end()) {
+                it->receivedBytes = receivedBytes;
+            }
+            break;
+        }
+        case RecordType::Complete: {
+            auto it = entries.find(id);
+            if (it != entries.end()) {
+                receivedPaths.insert(it->savePath);
+                entries.erase(it);
+            }
+            break;
+        }
+        case RecordType::Abort:
+            entries.remove(id);
+            break;
+        case RecordType::Received:
+        case RecordType::Forget: {
+            QString savePath;
+            in >> savePath;
+            if (static_cast<RecordType>(type) == RecordType::Received) {
+                receivedPaths.insert(savePath);
+            } else {
+                receivedPaths.remove(savePath);
+            }
+            break;
+        }
+    }
+}
+
+bool TransferJournal::compact() {
+    QSaveFile output(journalPath);
+    if (!output.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    
+    for (const Entry &entry : entries) {
+        QByteArray start;
+        QDataStream out(&start, QIODevice::WriteOnly);
+        out << quint8(RecordType::Start) << entry.id << entry.fileName << entry.savePath
+            << entry.fileSize << entry.startedAt << entry.fingerprint;
+        output.write(encodeRecord(start));
+        
+        if (entry.receivedBytes > 0) {
+            QByteArray checkpoint;
+            QDataStream cp(&checkpoint, QIODevice::WriteOnly);
+            cp << quint8(RecordType::Checkpoint) << entry.id << entry.receivedBytes;
+            output.write(encodeRecord(checkpoint));
+        }
+    }
+    
+    // 已在本地被删除的文件不再保留
+    for (auto it = receivedPaths.begin(); it != receivedPaths.end();) {
+        if (!QFile::exists(*it)) {
+            it = receivedPaths.erase(it);
+            continue;
+        }
+        QByteArray received;
+        QDataStream out(&received, QIODevice::WriteOnly);
+        out << quint8(RecordType::Received) << quint64(0) << *it;
+        output.write(encodeRecord(received));
+        ++it;
+    }
+    return output.commit();
+}
+
+void TransferJournal::append(const QByteArray &payload) {
+    if (!file.isOpen()) {
+        return;
+    }
+    file.write(encodeRecord(payload));
+    syncFile(file);
+}
+
+bool TransferJournal::syncFile(QFile &file) {
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+QByteArray TransferJournal::encodeRecord(const QByteArray &payload) {
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out << quint32(payload.size()) << quint16(qChecksum(payload));
+    record.append(payload);
+    return record;
+}
\ No newline at end of file
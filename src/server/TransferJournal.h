@@ -0,0 +1,79 @@
+#pragma once
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+
+// 只追加的传输日志：记录文件接收的开始、检查点和完成，以及已接收完成的文件。
+// 重启时只需重放该日志即可恢复未完成的传输，无需扫描保存目录。
+// 每条记录带有长度和校验和，崩溃时写了一半的尾部记录在重放时被丢弃。
+// 每条记录写入后都同步到磁盘，断电或系统崩溃后日志也不会超前于实际写入的数据。
+class TransferJournal {
+public:
+    // 一个未完成的传输，[0, receivedBytes)已确认写入文件
+    struct Entry {
+        quint64 id;
+        QString fileName;
+        QString savePath;
+        qint64 fileSize;
+        qint64 receivedBytes;
+        qint64 startedAt;  // 毫秒时间戳
+        quint64 fingerprint;  // 发送端的源文件指纹，0表示未知
+    };
+
+    explicit TransferJournal(const QString &path);
+    ~TransferJournal();
+
+    // 重放并压缩日志，然后以追加方式打开
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    quint64 recordStart(const QString &fileName, const QString &savePath, qint64 fileSize,
+                        quint64 fingerprint = 0);
+    void recordCheckpoint(quint64 id, qint64 receivedBytes);
+    void recordComplete(quint64 id);
+    void recordAbort(quint64 id);
+    // 传输中断但保留在日志中(连接断开、停止服务等)，之后可以续传。
+    // 没有指纹的传输无法续传，直接删除部分文件并记录中止；调用前须已关闭该文件
+    void release(quint64 id);
+
+    // 未完成的传输
+    QList<Entry> interruptedTransfers() const;
+    
+    // 本服务器接收完成且尚未删除的文件(保存路径)，远程列出和删除只限于这些文件
+    QStringList receivedFiles() const;
+    bool isReceivedFile(const QString &savePath) const;
+    void forgetReceived(const QString &savePath);
+    
+    // 把文件数据刷到磁盘(fsync/FlushFileBuffers)，而不只是交给操作系统缓存
+    static bool syncFile(QFile &file);
+    // 查找文件名、大小和指纹都一致的可续传传输，找到后该传输重新变为进行中。
+    // 指纹为0时不续传，避免把另一个同名同大小文件的数据接在旧数据后面
+    bool takeResumable(const QString &fileName, qint64 fileSize, quint64 fingerprint, Entry &entry);
+
+private:
+    enum class RecordType : quint8 {
+        Start = 1,
+        Checkpoint = 2,
+        Complete = 3,
+        Abort = 4,
+        Received = 5,   // 压缩时写入，保留已完成文件的保存路径
+        Forget = 6      // 已完成的文件被远程删除
+    };
+
+    void replay(const QByteArray &data);
+    void applyRecord(const QByteArray &payload);
+    bool compact();
+    void append(const QByteArray &payload);
+    static QByteArray encodeRecord(const QByteArray &payload);
+
+    QString journalPath;
+    QFile file;
+    QHash<quint64, Entry> entries;      // 所有未完成的传输
+    QSet<quint64> activeIds;            // 本次运行中正在进行的传输
+    QSet<QString> receivedPaths;        // 已接收完成的文件
+    quint64 nextId;
+};
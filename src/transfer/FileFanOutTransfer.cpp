@@ -0,0 +1,347 @@
+#include "FileFanOutTransfer.h"
+#include "../Trace.h"
+#include <QFileInfo>
+#include <QDataStream>
+
+namespace {
+const qint64 blockSize = 64 * 1024;              // 64KB块大小，与FileTransfer一致
+const qint64 readAheadBytes = 4 * blockSize;     // 最快接收端的预读上限
+const qint64 socketWindow = 2 * blockSize;       // 每个socket内部缓冲的上限
+const qint64 defaultMaxBufferedBytes = 16 * 1024 * 1024;
+}
+
+FileFanOutTransfer::FileFanOutTransfer(QObject *parent)
+    : QObject(parent)
+    , currentFile(nullptr)
+    , totalBytes(0)
+    , maxBufferedBytes(defaultMaxBufferedBytes)
+    , evictSlowReceivers(false)
+    , transferring(false)
+    , nextReceiverId(0) {
+}
+
+FileFanOutTransfer::~FileFanOutTransfer() {
+    disconnect();
+    delete currentFile;
+}
+
+int FileFanOutTransfer::addReceiver(const QString &address, quint16 port) {
+    if (transferring) {
+        emit transferError("传输过程中无法添加接收端");
+        return -1;
+    }
+
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->connectToHost(address, port);
+    if (!socket->waitForConnected(5000)) { // 5秒超时
+        delete socket;
+        return -1;
+    }
+
+    connect(socket, &QTcpSocket::bytesWritten,
+            this, &FileFanOutTransfer::handleBytesWritten);
+    connect(socket, &QTcpSocket::disconnected,
+            this, &FileFanOutTransfer::handleDisconnected);
+    connect(socket, &QTcpSocket::errorOccurred,
+            this, &FileFanOutTransfer::handleError);
+
+    Receiver receiver;
+    receiver.id = nextReceiverId++;
+    receiver.socket = socket;
+    receiver.pendingBytes = 0;
+    receiver.bytesWritten = 0;
+    receiver.active = false;
+    receiver.completed = false;
+    receivers.append(receiver);
+    return receiver.id;
+}
+
+void FileFanOutTransfer::setMaxBufferedBytes(qint64 bytes) {
+    // 上限不能低于预读窗口，否则所有接收端都会被判定为慢速
+    maxBufferedBytes = qMax(bytes, readAheadBytes + blockSize);
+}
+
+void FileFanOutTransfer::setEvictSlowReceivers(bool evict) {
+    evictSlowReceivers = evict;
+}
+
+int FileFanOutTransfer::receiverCount() const {
+    int count = 0;
+    for (const Receiver &receiver : receivers) {
+        if (receiver.socket->state() == QAbstractSocket::ConnectedState) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void FileFanOutTransfer::disconnect() {
+    if (transferring) {
+        cancelTransfer();
+    }
+
+    for (Receiver &receiver : receivers) {
+        receiver.socket->disconnectFromHost();
+        receiver.socket->deleteLater();
+    }
+    receivers.clear();
+}
+
+bool FileFanOutTransfer::sendFile(const QString &filePath) {
+    if (transferring) {
+        emit transferError("当前正在传输文件");
+        return false;
+    }
+
+    if (receiverCount() == 0) {
+        emit transferError("没有可用的接收端");
+        return false;
+    }
+
+    currentFile = new QFile(filePath);
+    if (!currentFile->open(QIODevice::ReadOnly)) {
+        emit transferError("无法打开文件: " + filePath);
+        delete currentFile;
+        currentFile = nullptr;
+        return false;
+    }
+
+    totalBytes = currentFile->size();
+    header = buildFileHeader();
+    transferring = true;
+
+    // 文件头同样以共享块的形式加入每个接收端的队列
+    for (Receiver &receiver : receivers) {
+        receiver.pending.clear();
+        receiver.pendingBytes = 0;
+        receiver.bytesWritten = 0;
+        receiver.completed = false;
+        receiver.active = receiver.socket->state() == QAbstractSocket::ConnectedState;
+        if (receiver.active) {
+            receiver.pending.enqueue(header);
+            receiver.pendingBytes = header.size();
+            pumpReceiver(receiver);
+        }
+    }
+
+    readAndDispatch();
+    return transferring;
+}
+
+void FileFanOutTransfer::cancelTransfer() {
+    if (!transferring) return;
+
+    // 中断未完成的接收端，避免对端把后续数据当作本文件内容
+    for (Receiver &receiver : receivers) {
+        if (receiver.active) {
+            dropReceiver(receiver);
+        }
+    }
+    resetTransfer();
+    emit transferError("传输已取消");
+}
+
+void FileFanOutTransfer::handleBytesWritten(qint64 bytes) {
+    Receiver *receiver = findReceiver(sender());
+    if (!transferring || !receiver || !receiver->active) return;
+
+    receiver->bytesWritten += bytes;
+    qint64 bytesSent = qMax<qint64>(0, receiver->bytesWritten - header.size());
+    emit receiverProgress(receiver->id, bytesSent, totalBytes);
+    if (!transferring || !receiver->active) return;
+
+    if (bytesSent >= totalBytes) {
+        // 该接收端已写出全部数据
+        receiver->active = false;
+        receiver->completed = true;
+        emit receiverCompleted(receiver->id);
+    } else {
+        pumpReceiver(*receiver);
+    }
+
+    // 该接收端可能正是阻塞读取的那个，继续读取下一块
+    readAndDispatch();
+}
+
+void FileFanOutTransfer::handleDisconnected() {
+    Receiver *receiver = findReceiver(sender());
+    if (!receiver || !receiver->active || !transferring) return;
+
+    emit receiverError(receiver->id, "接收端已断开");
+    dropReceiver(*receiver);
+    readAndDispatch();
+}
+
+void FileFanOutTransfer::handleError(QAbstractSocket::SocketError socketError) {
+    Q_UNUSED(socketError);
+    Receiver *receiver = findReceiver(sender());
+    if (!receiver) return;
+
+    emit receiverError(receiver->id, receiver->socket->errorString());
+    if (receiver->active && transferring) {
+        dropReceiver(*receiver);
+        readAndDispatch();
+    }
+}
+
+FileFanOutTransfer::Receiver *FileFanOutTransfer::findReceiver(QObject *socket) {
+    for (Receiver &receiver : receivers) {
+        if (receiver.socket == socket) {
+            return &receiver;
+        }
+    }
+    return nullptr;
+}
+
+void FileFanOutTransfer::pumpReceiver(Receiver &receiver) {
+    // 只向socket交付有限的数据，其余保留在共享块队列中，
+    // 避免QTcpSocket内部缓冲为慢速接收端无限增长
+    while (receiver.active && !receiver.pending.isEmpty()
+           && receiver.socket->bytesToWrite() < socketWindow) {
+        QByteArray block = receiver.pending.dequeue();
+        receiver.pendingBytes -= block.size();
+
+        qint64 written = receiver.socket->write(block);
+        if (written != block.size()) {
+            failedReceivers.append({receiver.id, receiver.socket->errorString()});
+            dropReceiver(receiver);
+            return;
+        }
+    }
+}
+
+void FileFanOutTransfer::readAndDispatch() {
+    while (transferring && currentFile && !currentFile->atEnd()) {
+        // 以最快的接收端决定是否继续预读
+        qint64 minPending = -1;
+        for (const Receiver &receiver : receivers) {
+            if (receiver.active && (minPending < 0 || receiver.pendingBytes < minPending)) {
+                minPending = receiver.pendingBytes;
+            }
+        }
+        if (minPending < 0 || minPending >= readAheadBytes) {
+            break;
+        }
+
+        // 落后过多的接收端：剔除，或者暂停读取等待其追上
+        bool blocked = false;
+        bool anyActive = false;
+        for (Receiver &receiver : receivers) {
+            if (!receiver.active) continue;
+            if (receiver.pendingBytes + blockSize <= maxBufferedBytes) {
+                anyActive = true;
+            } else if (evictSlowReceivers) {
+                dropReceiver(receiver);
+                evictedIds.append(receiver.id);
+            } else {
+                blocked = true;
+            }
+        }
+        if (blocked || !anyActive || !transferring) {
+            break;
+        }
+
+        // 每个数据块只从磁盘读取一次，各接收端共享同一份数据
+        QByteArray block;
+        {
+            FS_TRACE_SCOPE("FileFanOutTransfer::fileRead");
+            block = currentFile->read(blockSize);
+        }
+        if (block.isEmpty()) {
+            QString message = "读取文件失败: " + currentFile->errorString();
+            for (Receiver &receiver : receivers) {
+                if (receiver.active) {
+                    dropReceiver(receiver);
+                }
+            }
+            resetTransfer();
+            emitDeferredSignals();
+            emit transferError(message);
+            return;
+        }
+
+        for (Receiver &receiver : receivers) {
+            if (!receiver.active) continue;
+            receiver.pending.enqueue(block);
+            receiver.pendingBytes += block.size();
+            pumpReceiver(receiver);
+        }
+    }
+
+    // 槽函数可能调用disconnect()或cancelTransfer()，checkFinished会重新检查状态
+    emitDeferredSignals();
+    checkFinished();
+}
+
+void FileFanOutTransfer::emitDeferredSignals() {
+    QList<int> evicted;
+    QList<QPair<int, QString>> failed;
+    evicted.swap(evictedIds);
+    failed.swap(failedReceivers);
+
+    for (int id : evicted) {
+        emit receiverEvicted(id);
+    }
+    for (const auto &failure : failed) {
+        emit receiverError(failure.first, failure.second);
+    }
+}
+
+void FileFanOutTransfer::dropReceiver(Receiver &receiver) {
+    receiver.active = false;
+    receiver.pending.clear();
+    receiver.pendingBytes = 0;
+    receiver.socket->abort();
+}
+
+void FileFanOutTransfer::checkFinished() {
+    if (!transferring) return;
+
+    int completedCount = 0;
+    for (const Receiver &receiver : receivers) {
+        if (receiver.active) {
+            return;
+        }
+        if (receiver.completed) {
+            ++completedCount;
+        }
+    }
+
+    resetTransfer();
+    if (completedCount > 0) {
+        emit transferCompleted();
+    } else {
+        emit transferError("所有接收端均已断开");
+    }
+}
+
+void FileFanOutTransfer::resetTransfer() {
+    if (currentFile) {
+        currentFile->close();
+        delete currentFile;
+        currentFile = nullptr;
+    }
+
+    for (Receiver &receiver : receivers) {
+        receiver.pending.clear();
+        receiver.pendingBytes = 0;
+        receiver.active = false;
+    }
+
+    transferring = false;
+    totalBytes = 0;
+    header.clear();
+}
+
+QByteArray FileFanOutTransfer::buildFileHeader() const {
+    QFileInfo fileInfo(*currentFile);
+    QByteArray fileNameData = fileInfo.fileName().toUtf8();
+
+    // 与FileTransfer相同的文件头格式
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << totalBytes;  // 文件大小(8字节)
+    stream << (qint32)fileNameData.size();  // 文件名长度(4字节)
+    data.append(fileNameData);  // 文件名
+    return data;
+}
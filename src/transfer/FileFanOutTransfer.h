@@ -0,0 +1,76 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QTcpSocket>
+#include <QFile>
+#include <QQueue>
+#include <QVector>
+
+// 一对多文件发送：源文件每个数据块只读取一次，
+// 以共享(引用计数)的QByteArray分发给所有接收端
+class FileFanOutTransfer : public QObject {
+    Q_OBJECT
+public:
+    explicit FileFanOutTransfer(QObject *parent = nullptr);
+    ~FileFanOutTransfer();
+
+    // 连接一个接收端，成功返回接收端编号，失败返回-1
+    int addReceiver(const QString &address, quint16 port = 8080);
+    // 每个接收端允许积压的最大字节数
+    void setMaxBufferedBytes(qint64 bytes);
+    // 积压超过上限时是否剔除慢速接收端(否则暂停读取等待其追上)
+    void setEvictSlowReceivers(bool evict);
+    // 向所有接收端发送文件
+    bool sendFile(const QString &filePath);
+    // 取消传输
+    void cancelTransfer();
+    // 断开所有接收端
+    void disconnect();
+    // 获取接收端数量
+    int receiverCount() const;
+
+signals:
+    void receiverProgress(int receiverId, qint64 bytesSent, qint64 totalBytes);
+    void receiverCompleted(int receiverId);
+    void receiverEvicted(int receiverId);
+    void receiverError(int receiverId, const QString &error);
+    void transferCompleted();
+    void transferError(const QString &error);
+
+private slots:
+    void handleBytesWritten(qint64 bytes);
+    void handleDisconnected();
+    void handleError(QAbstractSocket::SocketError socketError);
+
+private:
+    struct Receiver {
+        int id;
+        QTcpSocket *socket;
+        QQueue<QByteArray> pending;  // 尚未写入socket的共享数据块
+        qint64 pendingBytes;
+        qint64 bytesWritten;         // socket已确认写出的字节数(含文件头)
+        bool active;
+        bool completed;
+    };
+
+    Receiver *findReceiver(QObject *socket);
+    void pumpReceiver(Receiver &receiver);
+    void readAndDispatch();
+    void dropReceiver(Receiver &receiver);
+    void emitDeferredSignals();
+    void checkFinished();
+    void resetTransfer();
+    QByteArray buildFileHeader() const;
+
+    QVector<Receiver> receivers;
+    // 遍历receivers期间产生的信号，遍历结束后再发出，避免槽函数修改receivers
+    QList<int> evictedIds;
+    QList<QPair<int, QString>> failedReceivers;
+    QFile *currentFile;
+    QByteArray header;
+    qint64 totalBytes;
+    qint64 maxBufferedBytes;
+    bool evictSlowReceivers;
+    bool transferring;
+    int nextReceiverId;
+};
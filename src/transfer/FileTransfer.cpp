@@ -1,14 +1,36 @@
 #include "FileTransfer.h"
+#include "../Trace.h"
 #include <QFileInfo>
 #include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QtEndian>
+
+namespace {
+// 源文件指纹：大小、修改时间和首个64KB块的摘要。
+// 同名同大小但内容不同的文件指纹不同，服务端不会把它接在旧的部分数据后面
+quint64 fileFingerprint(QFile *file) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QByteArray meta;
+    QDataStream stream(&meta, QIODevice::WriteOnly);
+    stream << file->size() << QFileInfo(*file).lastModified().toMSecsSinceEpoch();
+    hash.addData(meta);
+    hash.addData(file->peek(64 * 1024));
+    quint64 fingerprint = qFromLittleEndian<quint64>(hash.result().constData());
+    return fingerprint != 0 ? fingerprint : 1;  // 0保留为"未知"
+}
+}
 
 FileTransfer::FileTransfer(QObject *parent)
     : QObject(parent)
     , socket(new QTcpSocket(this))
-    , currentFile(nullptr)
-    , totalBytes(0)
-    , bytesSent(0)
-    , transferring(false) {
+    , nextStreamId(1)
+    , lastStreamId(0)
+    , lastWriteTraceNs(0)
+    , protocolVersion(2)
+    , resumeEnabled(true)
+    , helloSent(false)
+    , processingFrames(false) {
     
     connect(socket, &QTcpSocket::connected,
             this, &FileTransfer::handleConnected);
@@ -16,13 +38,15 @@ FileTransfer::FileTransfer(QObject *parent)
             this, &FileTransfer::handleDisconnected);
     connect(socket, &QTcpSocket::bytesWritten,
             this, &FileTransfer::handleBytesWritten);
+    connect(socket, &QTcpSocket::readyRead,
+            this, &FileTransfer::handleReadyRead);
     connect(socket, &QTcpSocket::errorOccurred,
             this, &FileTransfer::handleError);
 }
 
 FileTransfer::~FileTransfer() {
     disconnect();
-    delete currentFile;
+    resetTransfer();
 }
 
 bool FileTransfer::connectToServer(const QString &address, quint16 port) {
@@ -30,12 +54,21 @@ bool FileTransfer::connectToServer(const QString &address, quint16 port) {
         return true;
     }
     
+    helloSent = false;
     socket->connectToHost(address, port);
     return socket->waitForConnected(5000); // 5秒超时
 }
 
+void FileTransfer::setProtocolVersion(int version) {
+    if (!streams.isEmpty()) {
+        emit transferError("传输过程中无法切换协议版本");
+        return;
+    }
+    protocolVersion = version == 1 ? 1 : 2;
+}
+
 void FileTransfer::disconnect() {
-    if (transferring) {
+    if (!streams.isEmpty()) {
         cancelTransfer();
     }
     
@@ -48,68 +81,144 @@ bool FileTransfer::isConnected() const {
     return socket->state() == QAbstractSocket::ConnectedState;
 }
 
+void FileTransfer::setResumeEnabled(bool enabled) {
+    resumeEnabled = enabled;
+}
+
 bool FileTransfer::sendFile(const QString &filePath) {
+    return addFile(filePath) != 0;
+}
+
+quint32 FileTransfer::addFile(const QString &filePath) {
     if (!isConnected()) {
         emit transferError("未连接到服务器");
-        return false;
+        return 0;
     }
     
-    if (transferring) {
+    // v1协议一次只能传输一个文件
+    if (protocolVersion == 1 && !streams.isEmpty()) {
         emit transferError("当前正在传输文件");
-        return false;
+        return 0;
     }
     
-    currentFile = new QFile(filePath);
-    if (!currentFile->open(QIODevice::ReadOnly)) {
+    QFile *file = new QFile(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
         emit transferError("无法打开文件: " + filePath);
-        delete currentFile;
-        currentFile = nullptr;
-        return false;
+        delete file;
+        return 0;
     }
     
-    totalBytes = currentFile->size();
-    bytesSent = 0;
-    transferring = true;
+    quint32 streamId = nextStreamId++;
+    bool waitForAccept = protocolVersion == 2 && resumeEnabled;
+    quint64 fingerprint = waitForAccept ? fileFingerprint(file) : 0;
+    streams.insert(streamId, OutgoingStream{file, file->size(), 0, !waitForAccept, false, fingerprint});
     
     // 发送文件头信息
-    if (!sendFileHeader()) {
-        resetTransfer();
-        return false;
+    if (!sendFileHeader(streamId)) {
+        removeStream(streamId);
+        return 0;
     }
     
     // 开始发送文件数据
-    return sendFileData();
+    sendFileData();
+    return streamId;
 }
 
 void FileTransfer::cancelTransfer() {
-    if (transferring) {
-        resetTransfer();
+    if (streams.isEmpty()) {
+        return;
+    }
+    
+    if (protocolVersion == 2 && isConnected()) {
+        for (auto it = streams.begin(); it != streams.end(); ++it) {
+            writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::Cancel, it.key()));
+        }
+    }
+    resetTransfer();
+    emit transferError("传输已取消");
+}
+
+void FileTransfer::cancelStream(quint32 streamId) {
+    if (!streams.contains(streamId)) {
+        return;
+    }
+    
+    // v1协议无法只取消单个文件
+    if (protocolVersion == 1) {
+        cancelTransfer();
+        return;
+    }
+    
+    if (isConnected()) {
+        writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::Cancel, streamId));
+    }
+    removeStream(streamId);
+    if (streams.isEmpty()) {
         emit transferError("传输已取消");
     }
 }
 
+bool FileTransfer::requestFileList() {
+    if (!isConnected() || protocolVersion != 2) {
+        return false;
+    }
+    
+    ensureHello();
+    return writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::ListRequest,
+                                               WireProtocol::ControlStreamId));
+}
+
+bool FileTransfer::requestDelete(const QString &fileName) {
+    if (!isConnected() || protocolVersion != 2) {
+        return false;
+    }
+    
+    ensureHello();
+    quint32 requestId = nextStreamId++;
+    pendingDeletes.insert(requestId, fileName);
+    return writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::DeleteRequest,
+                                               requestId, fileName.toUtf8()));
+}
+
 void FileTransfer::handleConnected() {
     emit connected();
 }
 
 void FileTransfer::handleDisconnected() {
     resetTransfer();
+    pendingDeletes.clear();
+    readBuffer.clear();
+    listBuffer.clear();
+    helloSent = false;
     emit disconnected();
 }
 
 void FileTransfer::handleBytesWritten(qint64 bytes) {
-    if (!transferring) return;
+    Q_UNUSED(bytes);
+    // 从写入socket到收到bytesWritten之间的等待时间
+    FS_TRACE_SPAN("FileTransfer::waitBytesWritten", lastWriteTraceNs, FS_TRACE_NOW());
+    FS_TRACE_COUNTER("FileTransfer::bytesToWrite", socket->bytesToWrite());
+    if (streams.isEmpty()) return;
     
-    bytesSent += bytes;
-    emit transferProgress(bytesSent, totalBytes);
+    // v1协议没有确认消息，数据全部写出即视为完成
+    if (protocolVersion == 1) {
+        auto it = streams.begin();
+        if (it->closeSent && socket->bytesToWrite() == 0) {
+            finishStream(it.key());
+            return;
+        }
+    }
     
-    if (bytesSent < totalBytes) {
-        // 继续发送数据
-        sendFileData();
-    } else if (bytesSent >= totalBytes) {
-        // 传输完成
-        emit transferCompleted();
-        resetTransfer();
+    // 继续发送数据
+    sendFileData();
+}
+
+void FileTransfer::handleReadyRead() {
+    readBuffer.append(socket->readAll());
+    if (protocolVersion == 2) {
+        processFrames();
+    } else {
+        readBuffer.clear();
     }
 }
 
@@ -119,48 +228,226 @@ void FileTransfer::handleError(QAbstractSocket::SocketError socketError) {
     resetTransfer();
 }
 
-bool FileTransfer::sendFileHeader() {
-    QFileInfo fileInfo(*currentFile);
+bool FileTransfer::sendFileHeader(quint32 streamId) {
+    const OutgoingStream &outgoing = streams[streamId];
+    QFileInfo fileInfo(*outgoing.file);
     QString fileName = fileInfo.fileName();
     QByteArray fileNameData = fileName.toUtf8();
     
+    if (protocolVersion == 2) {
+        ensureHello();
+        quint16 flags = outgoing.accepted ? 0 : WireProtocol::FlagResume;
+        return writeData(WireProtocol::encodeFileOpen(streamId, outgoing.totalBytes, fileNameData,
+                                                      flags, outgoing.fingerprint));
+    }
+    
     // 构造文件头信息
     QByteArray header;
     QDataStream stream(&header, QIODevice::WriteOnly);
-    stream << totalBytes;  // 文件大小(8字节)
+    stream << outgoing.totalBytes;  // 文件大小(8字节)
     stream << (qint32)fileNameData.size();  // 文件名长度(4字节)
     header.append(fileNameData);  // 文件名
     
     // 发送头信息
-    qint64 written = socket->write(header);
-    return written == header.size();
+    return writeData(header);
 }
 
-bool FileTransfer::sendFileData() {
+void FileTransfer::sendFileData() {
     static const qint64 blockSize = 64 * 1024; // 64KB块大小
+    static const qint64 socketWindow = 2 * blockSize;
     
-    if (!currentFile || !transferring) {
-        return false;
+    FS_TRACE_SCOPE("FileTransfer::sendFileData");
+    // 只在socket缓冲较少时读取，多个文件流按编号轮流发送一块，
+    // 大文件不会阻塞其他文件
+    while (isConnected() && socket->bytesToWrite() < socketWindow) {
+        auto it = streams.upperBound(lastStreamId);
+        int checked = 0;
+        for (; checked < streams.size(); ++checked, ++it) {
+            if (it == streams.end()) {
+                it = streams.begin();
+            }
+            if (it->accepted && !it->closeSent) {
+                break;
+            }
+        }
+        if (checked == streams.size()) {
+            return;
+        }
+        
+        quint32 streamId = it.key();
+        OutgoingStream &stream = it.value();
+        lastStreamId = streamId;
+        
+        // 读取并发送数据块
+        QByteArray block;
+        {
+            FS_TRACE_SCOPE("FileTransfer::fileRead");
+            block = stream.file->read(blockSize);
+        }
+        if (!block.isEmpty()) {
+            if (protocolVersion == 2) {
+                WireProtocol::FrameHeader header = WireProtocol::makeHeader(
+                    WireProtocol::FrameType::FileData, streamId, quint32(block.size()));
+                writeData(QByteArray::fromRawData(reinterpret_cast<const char *>(&header),
+                                                  WireProtocol::HeaderSize));
+            }
+            writeData(block);
+            stream.bytesSent += block.size();
+        }
+        
+        if (block.isEmpty() || stream.file->atEnd()) {
+            if (protocolVersion == 2) {
+                writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::FileClose, streamId));
+            }
+            stream.closeSent = true;
+            stream.file->close();
+        }
+        
+        qint64 bytesSent = stream.bytesSent;
+        qint64 totalBytes = stream.totalBytes;
+        emit streamProgress(streamId, bytesSent, totalBytes);
+        emitTotalProgress();
+    }
+}
+
+bool FileTransfer::writeData(const QByteArray &data) {
+    lastWriteTraceNs = FS_TRACE_NOW();
+    qint64 written = socket->write(data);
+    return written == data.size();
+}
+
+void FileTransfer::ensureHello() {
+    if (!helloSent) {
+        writeData(WireProtocol::encodeFrame(WireProtocol::FrameType::Hello,
+                                            WireProtocol::ControlStreamId));
+        helloSent = true;
+    }
+}
+
+void FileTransfer::processFrames() {
+    // 信号处理中可能进入嵌套事件循环，新数据留给外层循环处理
+    if (processingFrames) {
+        return;
     }
+    processingFrames = true;
     
-    // 读取并发送数据块
-    QByteArray block = currentFile->read(blockSize);
-    if (!block.isEmpty()) {
-        qint64 written = socket->write(block);
-        return written == block.size();
+    qsizetype offset = 0;
+    while (readBuffer.size() - offset >= WireProtocol::HeaderSize) {
+        const WireProtocol::FrameHeader header = WireProtocol::readHeader(readBuffer.constData() + offset);
+        if (!WireProtocol::isValidHeader(header)) {
+            processingFrames = false;
+            readBuffer.clear();
+            emit transferError("收到无效的数据帧");
+            socket->abort();
+            return;
+        }
+        
+        qsizetype frameSize = WireProtocol::HeaderSize + header.payloadSize;
+        if (readBuffer.size() - offset < frameSize) {
+            break;
+        }
+        
+        handleFrame(header, readBuffer.constData() + offset + WireProtocol::HeaderSize);
+        offset += frameSize;
     }
+    readBuffer.remove(0, offset);
+    processingFrames = false;
+}
+
+void FileTransfer::handleFrame(const WireProtocol::FrameHeader &header, const char *payload) {
+    using WireProtocol::FrameType;
     
-    return true;
+    switch (static_cast<FrameType>(header.type)) {
+        case FrameType::Ack: {
+            if (header.payloadSize < sizeof(WireProtocol::AckPayload)) break;
+            const WireProtocol::AckPayload ack = WireProtocol::readAck(payload);
+            
+            if (pendingDeletes.contains(header.streamId)) {
+                emit deleteCompleted(pendingDeletes.take(header.streamId), ack.status == 0);
+            } else if (streams.contains(header.streamId)) {
+                if (ack.status == 0) {
+                    finishStream(header.streamId);
+                } else {
+                    removeStream(header.streamId);
+                    emit transferError("服务端接收的文件不完整");
+                }
+            }
+            break;
+        }
+        case FrameType::FileAccept: {
+            if (header.payloadSize < sizeof(WireProtocol::AckPayload)) break;
+            auto it = streams.find(header.streamId);
+            if (it == streams.end() || it->accepted) break;
+            
+            // 服务端已有部分数据，从其确认的偏移处继续发送
+            qint64 offset = qMin<qint64>(WireProtocol::readAck(payload).bytes, it->totalBytes);
+            if (offset > 0 && !it->file->seek(offset)) {
+                cancelStream(header.streamId);
+                break;
+            }
+            it->bytesSent = offset;
+            it->accepted = true;
+            sendFileData();
+            break;
+        }
+        case FrameType::ListResponse:
+            listBuffer.append(payload, header.payloadSize);
+            if (!(header.flags & WireProtocol::FlagMore)) {
+                QStringList files = QString::fromUtf8(listBuffer).split('\n', Qt::SkipEmptyParts);
+                listBuffer.clear();
+                emit fileListReceived(files);
+            }
+            break;
+        case FrameType::Error: {
+            QString message = QString::fromUtf8(payload, header.payloadSize);
+            if (pendingDeletes.contains(header.streamId)) {
+                emit deleteCompleted(pendingDeletes.take(header.streamId), false);
+            } else {
+                removeStream(header.streamId);
+                emit transferError(message);
+            }
+            break;
+        }
+        default:
+            break;
+    }
 }
 
-void FileTransfer::resetTransfer() {
-    if (currentFile) {
-        currentFile->close();
-        delete currentFile;
-        currentFile = nullptr;
+void FileTransfer::finishStream(quint32 streamId) {
+    removeStream(streamId);
+    emit streamCompleted(streamId);
+    
+    if (streams.isEmpty()) {
+        // 传输完成
+        emit transferCompleted();
+    }
+}
+
+void FileTransfer::removeStream(quint32 streamId) {
+    auto it = streams.find(streamId);
+    if (it == streams.end()) {
+        return;
     }
     
-    transferring = false;
-    totalBytes = 0;
-    bytesSent = 0;
-} 
\ No newline at end of file
+    it->file->close();
+    delete it->file;
+    streams.erase(it);
+}
+
+void FileTransfer::emitTotalProgress() {
+    qint64 bytesSent = 0;
+    qint64 totalBytes = 0;
+    for (const OutgoingStream &stream : streams) {
+        bytesSent += stream.bytesSent;
+        totalBytes += stream.totalBytes;
+    }
+    emit transferProgress(bytesSent, totalBytes);
+}
+
+void FileTransfer::resetTransfer() {
+    for (OutgoingStream &stream : streams) {
+        stream.file->close();
+        delete stream.file;
+    }
+    streams.clear();
+}
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QTcpSocket>
 #include <QFile>
+#include <QMap>
+#include <QHash>
+#include "../protocol/WireProtocol.h"
 
 class FileTransfer : public QObject {
     Q_OBJECT
@@ -12,10 +16,22 @@ public:
     
     // 连接到服务器
     bool connectToServer(const QString &address, quint16 port = 8080);
+    // 设置协议版本(1或2)，默认为2；连接旧版服务端时设为1
+    void setProtocolVersion(int version);
+    // 设置是否请求断点续传(仅v2)，默认开启
+    void setResumeEnabled(bool enabled);
     // 发送文件
     bool sendFile(const QString &filePath);
+    // 加入一个文件流，返回流编号(失败返回0)；v2协议下多个文件交错传输
+    quint32 addFile(const QString &filePath);
     // 取消传输
     void cancelTransfer();
+    // 取消单个文件流
+    void cancelStream(quint32 streamId);
+    // 请求服务端文件列表(仅v2)
+    bool requestFileList();
+    // 请求删除服务端文件(仅v2)
+    bool requestDelete(const QString &fileName);
     // 断开连接
     void disconnect();
     // 获取连接状态
@@ -27,21 +43,50 @@ signals:
     void transferProgress(qint64 bytesSent, qint64 totalBytes);
     void transferCompleted();
     void transferError(const QString &error);
+    void streamProgress(quint32 streamId, qint64 bytesSent, qint64 totalBytes);
+    void streamCompleted(quint32 streamId);
+    void fileListReceived(const QStringList &files);
+    void deleteCompleted(const QString &fileName, bool success);
 
 private slots:
     void handleConnected();
     void handleDisconnected();
     void handleBytesWritten(qint64 bytes);
+    void handleReadyRead();
     void handleError(QAbstractSocket::SocketError socketError);
 
 private:
+    // 一个正在发送的文件
+    struct OutgoingStream {
+        QFile *file;
+        qint64 totalBytes;
+        qint64 bytesSent;
+        bool accepted;   // 请求续传时，收到FileAccept之前不发送数据
+        bool closeSent;
+        quint64 fingerprint;  // 源文件指纹，服务端据此判断能否续传
+    };
+
     void resetTransfer();
-    bool sendFileHeader();
-    bool sendFileData();
+    bool sendFileHeader(quint32 streamId);
+    void sendFileData();
+    bool writeData(const QByteArray &data);
+    void ensureHello();
+    void processFrames();
+    void handleFrame(const WireProtocol::FrameHeader &header, const char *payload);
+    void finishStream(quint32 streamId);
+    void removeStream(quint32 streamId);
+    void emitTotalProgress();
 
     QTcpSocket *socket;
-    QFile *currentFile;
-    qint64 totalBytes;
-    qint64 bytesSent;
-    bool transferring;
+    QMap<quint32, OutgoingStream> streams;
+    QHash<quint32, QString> pendingDeletes;
+    QByteArray readBuffer;
+    QByteArray listBuffer;
+    quint32 nextStreamId;
+    quint32 lastStreamId;
+    quint64 lastWriteTraceNs;  // 最近一次写socket的时间，仅用于追踪
+    int protocolVersion;
+    bool resumeEnabled;
+    bool helloSent;
+    bool processingFrames;
 }; 
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QNetworkInterface>
 #include <QMessageBox>
+#include <QStatusBar>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     setupUi();
@@ -11,6 +12,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     
     connect(fileServer, &FileServer::clientConnected,
             this, &MainWindow::handleClientConnected);
+    connect(fileServer, &FileServer::clientDisconnected,
+            this, &MainWindow::handleClientDisconnected);
     connect(fileServer, &FileServer::fileReceiveStarted,
             this, &MainWindow::handleFileReceiveStarted);
     connect(fileServer, &FileServer::fileReceiveProgress,
@@ -84,6 +87,7 @@ void MainWindow::handleStopServer() {
     startServerButton->setEnabled(true);
     stopServerButton->setEnabled(false);
     connectionLabel->setText("等待连接...");
+    receivingFiles.clear();
     progressBar->setVisible(false);
 }
 
@@ -91,19 +95,52 @@ void MainWindow::handleClientConnected(const QString &clientAddress) {
     connectionLabel->setText("已连接客户端: " + clientAddress);
 }
 
-void MainWindow::handleFileReceiveStarted(const QString &fileName, qint64 fileSize) {
-    statusLabel->setText("正在接收文件: " + fileName);
-    progressBar->setVisible(true);
-    progressBar->setMaximum(fileSize);
-    progressBar->setValue(0);
+void MainWindow::handleClientDisconnected() {
+    connectionLabel->setText("等待连接...");
+    // 未完成的文件随连接断开而中止
+    receivingFiles.clear();
+    progressBar->setVisible(false);
 }
 
-void MainWindow::handleFileReceiveProgress(qint64 bytesReceived) {
-    progressBar->setValue(bytesReceived);
+void MainWindow::handleFileReceiveStarted(quint32 streamId, const QString &fileName, qint64 fileSize) {
+    receivingFiles.insert(streamId, ReceivingFile{fileName, fileSize, 0});
+    updateReceiveProgress();
 }
 
-void MainWindow::handleFileReceiveCompleted() {
-    statusLabel->setText("文件接收完成");
-    progressBar->setVisible(false);
-    QMessageBox::information(this, "完成", "文件传输完成！");
-} 
\ No newline at end of file
+void MainWindow::handleFileReceiveProgress(quint32 streamId, qint64 bytesReceived) {
+    auto it = receivingFiles.find(streamId);
+    if (it == receivingFiles.end()) return;
+    it->bytesReceived = bytesReceived;
+    updateReceiveProgress();
+}
+
+void MainWindow::handleFileReceiveCompleted(quint32 streamId, const QString &fileName) {
+    receivingFiles.remove(streamId);
+    updateReceiveProgress();
+    if (receivingFiles.isEmpty()) {
+        statusLabel->setText("文件接收完成");
+    }
+    // 不使用模态对话框：它的嵌套事件循环会在接收过程中暂停所有文件流
+    statusBar()->showMessage("文件传输完成：" + fileName, 5000);
+}
+
+void MainWindow::updateReceiveProgress() {
+    if (receivingFiles.isEmpty()) {
+        progressBar->setVisible(false);
+        return;
+    }
+    
+    // 同时接收多个文件时显示总进度，以百分比表示避免超过int范围
+    QStringList names;
+    qint64 totalSize = 0;
+    qint64 totalReceived = 0;
+    for (const ReceivingFile &file : receivingFiles) {
+        names.append(file.fileName);
+        totalSize += file.fileSize;
+        totalReceived += file.bytesReceived;
+    }
+    statusLabel->setText("正在接收文件: " + names.join(", "));
+    progressBar->setVisible(true);
+    progressBar->setMaximum(100);
+    progressBar->setValue(totalSize > 0 ? int(totalReceived * 100 / totalSize) : 0);
+}
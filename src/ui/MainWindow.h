@@ -3,6 +3,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QProgressBar>
+#include <QHash>
 #include "../server/FileServer.h"
 
 class MainWindow : public QMainWindow {
@@ -12,15 +13,25 @@ public:
 
 private slots:
     void handleClientConnected(const QString &clientAddress);
-    void handleFileReceiveStarted(const QString &fileName, qint64 fileSize);
-    void handleFileReceiveProgress(qint64 bytesReceived);
-    void handleFileReceiveCompleted();
+    void handleClientDisconnected();
+    void handleFileReceiveStarted(quint32 streamId, const QString &fileName, qint64 fileSize);
+    void handleFileReceiveProgress(quint32 streamId, qint64 bytesReceived);
+    void handleFileReceiveCompleted(quint32 streamId, const QString &fileName);
     void handleStartServer();
     void handleStopServer();
 
 private:
+    // 正在接收的文件，按流编号区分
+    struct ReceivingFile {
+        QString fileName;
+        qint64 fileSize;
+        qint64 bytesReceived;
+    };
+    
     void setupUi();
+    void updateReceiveProgress();
     FileServer *fileServer;
+    QHash<quint32, ReceivingFile> receivingFiles;
     
     // UI组件
     QLabel *statusLabel;